@@ -44,6 +44,16 @@ cache_t *make_cache(int capacity, int block_size, int assoc, enum protocol_t pro
   return cache;
 }
 
+void free_cache(cache_t *cache) {
+  for (int i = 0; i < cache->n_set; i++) {
+    free(cache->lines[i]);
+  }
+  free(cache->lines);
+  free(cache->lru_way);
+  free(cache->stats);
+  free(cache);
+}
+
 /* Given a configured cache, returns the tag portion of the given address.
  *
  * Example: a cache with 4 bits each in tag, index, offset
@@ -51,10 +61,8 @@ cache_t *make_cache(int capacity, int block_size, int assoc, enum protocol_t pro
  * in decimal -- get_cache_tag(3921) returns 15 
  */
 unsigned long get_cache_tag(cache_t *cache, unsigned long addr) {
-  int mask = ~0;
-  mask = mask >> (ADDRESS_SIZE - cache->n_tag_bit);
-  addr = addr >> (ADDRESS_SIZE - cache->n_tag_bit);
-  return addr & mask;
+  // everything above the index is tag, no mask needed
+  return addr >> (ADDRESS_SIZE - cache->n_tag_bit);
 }
 
 /* Given a configured cache, returns the index portion of the given address.
@@ -64,11 +72,9 @@ unsigned long get_cache_tag(cache_t *cache, unsigned long addr) {
  * in decimal -- get_cache_index(3921) returns 5
  */
 unsigned long get_cache_index(cache_t *cache, unsigned long addr) {
-  uint mask = 0xffffffff;
+  unsigned long mask = (1UL << cache->n_index_bit) - 1;
   addr = (addr >> cache->n_offset_bit);
-  mask = mask >> (ADDRESS_SIZE - cache->n_index_bit);
   return mask & addr;
-  
 }
 
 /* Given a configured cache, returns the given address with the offset bits zeroed out.
@@ -94,7 +100,7 @@ unsigned long get_cache_block_addr(cache_t *cache, unsigned long addr) {
  */
 bool access_cache(cache_t *cache, unsigned long addr, enum action_t action) {
   int index = get_cache_index(cache, addr);
-  int tag = get_cache_tag(cache, addr);
+  unsigned long tag = get_cache_tag(cache, addr);
   bool hit = false;
   bool wb = false;
   int * lru = cache->lru_way;
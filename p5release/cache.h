@@ -5,7 +5,7 @@
 #include <stdlib.h>
 #include "cache_stats.h"
 
-#define ADDRESS_SIZE 32  // in bits
+#define ADDRESS_SIZE 64  // in bits
 #define HIT 1
 #define MISS 0
 
@@ -53,6 +53,7 @@ typedef struct {
 } cache_t;
 
 cache_t *make_cache(int capacity, int block_size, int assoc, enum protocol_t protocol, bool lru_on_invalidate_f);
+void free_cache(cache_t *cache);
 unsigned long get_cache_tag(cache_t *cache, unsigned long addr);
 unsigned long get_cache_index(cache_t *cache, unsigned long addr);
 unsigned long get_cache_block_addr(cache_t *cache, unsigned long addr);
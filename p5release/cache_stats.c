@@ -8,7 +8,12 @@
  */
 cache_stats_t *make_cache_stats() {
   cache_stats_t *stats = malloc(sizeof(cache_stats_t));
+  reset_cache_stats(stats);
+  return stats;
+}
 
+/* Zeroes every counter, e.g. to start a fresh measurement on a warm cache */
+void reset_cache_stats(cache_stats_t *stats) {
   stats->n_cpu_accesses = 0;
   stats->n_hits = 0;
   stats->n_stores = 0;
@@ -28,8 +33,6 @@ cache_stats_t *make_cache_stats() {
   
   stats->B_total_traffic_wb = 0;
   stats->B_total_traffic_wt = 0;
-
-  return stats;
 }
 
 /* This code assumes the only actions are LOAD and STORE. 
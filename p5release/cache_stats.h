@@ -29,6 +29,7 @@ typedef struct {
 } cache_stats_t;
 
 cache_stats_t *make_cache_stats();
+void reset_cache_stats(cache_stats_t *stats);
 void calculate_stat_rates(cache_stats_t *stats, int block_size);
 void update_stats(cache_stats_t *stats, bool hit_f, bool writeback_f, bool upgrade_miss_f, enum action_t action);
 
@@ -0,0 +1,184 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "compose.h"
+#include "trace_reader.h"
+#include "hash.h"
+
+composer_t *make_composer() {
+  composer_t *comp = malloc(sizeof(composer_t));
+
+  comp->n_src = 0;
+  comp->n_live = 0;
+  comp->live_weight = 0;
+
+  comp->schedule = SCHED_RR;
+  comp->burst = 64;
+  comp->seed = 1;
+  comp->rng = 0;
+
+  comp->cur = -1;
+  comp->left = 0;
+
+  return comp;
+}
+
+/* Adds a source trace described as
+ * name[,core=N][,weight=W][,offset=HEX][,format=F].
+ * By default the k-th source runs on core k with weight 1 and no offset.
+ * Returns 0 if the description is malformed.
+ */
+int parse_compose_src(composer_t *comp, char *spec) {
+  if (comp->n_src == MAX_COMPOSE_SRC) return 0;
+
+  compose_src_t *src = &comp->srcs[comp->n_src];
+  char *copy = strdup(spec);
+  char *field = strtok(copy, ",");
+  if (field == NULL) {
+    free(copy);
+    return 0;
+  }
+
+  src->name = field;
+  src->format = -1;
+  src->reader = NULL;
+  src->core = comp->n_src;
+  src->weight = 1;
+  src->offset = 0;
+  src->credit = 0;
+  src->done_f = false;
+
+  while ((field = strtok(NULL, ",")) != NULL) {
+    if (strncmp(field, "core=", 5) == 0)
+      src->core = atoi(field + 5);
+    else if (strncmp(field, "weight=", 7) == 0)
+      src->weight = atoi(field + 7);
+    else if (strncmp(field, "offset=", 7) == 0)
+      src->offset = strtoul(field + 7, NULL, 16);
+    else if (strncmp(field, "format=", 7) == 0 && parse_format(field + 7) >= 0)
+      src->format = parse_format(field + 7);
+    else
+      break;
+  }
+  // src->name points into copy, it is only ours to free on failure
+  if (field != NULL || src->core < 0 || src->weight <= 0) {
+    free(copy);
+    return 0;
+  }
+
+  comp->n_src++;
+  return 1;
+}
+
+void open_composer(composer_t *comp, simulator_t *sim) {
+  for (int i = 0; i < comp->n_src; i++) {
+    compose_src_t *src = &comp->srcs[i];
+    src->reader = make_trace_reader(open_trace(src->name),
+                                    src->format >= 0 ? src->format : sim->format,
+                                    sim->cache[0]->block_size, sim->ifetch_f, sim->profile);
+    // before the split, an unaligned offset would make pieces span blocks
+    src->reader->offset = src->offset;
+    comp->live_weight += comp->srcs[i].weight;
+  }
+  comp->n_live = comp->n_src;
+
+  comp->rng = seed_random(comp->seed);
+}
+
+/* the simulator needs at least this many cores for the merged trace */
+int composer_n_core(composer_t *comp) {
+  int n_core = 0;
+  for (int i = 0; i < comp->n_src; i++) {
+    if (comp->srcs[i].core + 1 > n_core) n_core = comp->srcs[i].core + 1;
+  }
+  return n_core;
+}
+
+char *schedule_to_str(enum schedule_t schedule) {
+  switch (schedule) {
+  case SCHED_RR:
+    return "rr";
+  case SCHED_WEIGHTED:
+    return "weighted";
+  case SCHED_BURST:
+    return "burst";
+  case SCHED_RANDOM:
+    return "random";
+  }
+  return "-";
+}
+
+static int next_live(composer_t *comp, int from) {
+  int i = from;
+  do {
+    i = (i + 1) % comp->n_src;
+  } while (comp->srcs[i].done_f);
+  return i;
+}
+
+/* Picks the source of the next access. Only called while n_live > 0. */
+static int pick_source(composer_t *comp) {
+  int best;
+  long r;
+
+  switch (comp->schedule) {
+  case SCHED_RR:
+    comp->cur = next_live(comp, comp->cur);
+    return comp->cur;
+
+  case SCHED_WEIGHTED:
+    // smooth weighted round robin: deterministic and evenly spread
+    best = -1;
+    for (int i = 0; i < comp->n_src; i++) {
+      if (comp->srcs[i].done_f) continue;
+      comp->srcs[i].credit += comp->srcs[i].weight;
+      if (best < 0 || comp->srcs[i].credit > comp->srcs[best].credit) best = i;
+    }
+    comp->srcs[best].credit -= comp->live_weight;
+    return best;
+
+  case SCHED_BURST:
+    if (comp->left > 0 && !comp->srcs[comp->cur].done_f) {
+      comp->left--;
+      return comp->cur;
+    }
+    comp->cur = next_live(comp, comp->cur);
+    comp->left = comp->burst * comp->srcs[comp->cur].weight - 1;
+    return comp->cur;
+
+  case SCHED_RANDOM:
+    r = next_random(&comp->rng) % comp->live_weight;
+    for (int i = 0; i < comp->n_src; i++) {
+      if (comp->srcs[i].done_f) continue;
+      r -= comp->srcs[i].weight;
+      if (r < 0) return i;
+    }
+  }
+  return next_live(comp, -1);
+}
+
+static void retire_source(composer_t *comp, compose_src_t *src) {
+  src->done_f = true;
+  free_trace_reader(src->reader);
+  src->reader = NULL;
+  comp->n_live--;
+  comp->live_weight -= src->weight;
+}
+
+bool compose_next(composer_t *comp, access_t *acc) {
+  while (comp->n_live > 0) {
+    compose_src_t *src = &comp->srcs[pick_source(comp)];
+
+    if (!trace_reader_next(src->reader, acc)) {
+      retire_source(comp, src);
+      continue;
+    }
+
+    // the core in the source trace is whatever thread it was recorded on
+    acc->core = src->core;
+    return true;
+  }
+  return false;
+}
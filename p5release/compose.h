@@ -0,0 +1,54 @@
+#ifndef __COMPOSE_H
+#define __COMPOSE_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "simulator.h"
+
+#define MAX_COMPOSE_SRC 256
+
+// how the composer picks the source of the next access
+enum schedule_t { SCHED_RR, SCHED_WEIGHTED, SCHED_BURST, SCHED_RANDOM };
+
+struct trace_reader_s;
+
+typedef struct {
+  char *name;
+  int format;             // an enum format_t, -1 for the simulator's
+  struct trace_reader_s *reader;
+
+  int core;               // core every access of this trace runs on
+  int weight;             // share of the accesses relative to the others
+  unsigned long offset;   // added to every address, e.g. to separate heaps
+  long credit;            // smooth weighted round robin bookkeeping
+
+  bool done_f;
+} compose_src_t;
+
+typedef struct composer_s {
+  compose_src_t srcs[MAX_COMPOSE_SRC];
+  int n_src;
+  int n_live;
+  long live_weight;       // sum of the weights of the sources still running
+
+  enum schedule_t schedule;
+  int burst;              // accesses per turn in burst mode (times weight)
+  unsigned long seed;
+  unsigned long rng;
+
+  int cur;                // source whose turn it is
+  int left;               // accesses it still gets this turn
+} composer_t;
+
+composer_t *make_composer();
+int parse_compose_src(composer_t *comp, char *spec);
+void open_composer(composer_t *comp, simulator_t *sim);
+int composer_n_core(composer_t *comp);
+char *schedule_to_str(enum schedule_t schedule);
+
+/* Fills in the next access of the merged trace and returns true, or
+ * returns false once every source trace has run out.
+ */
+bool compose_next(composer_t *comp, access_t *acc);
+
+#endif  // COMPOSE
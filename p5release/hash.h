@@ -0,0 +1,25 @@
+#ifndef __HASH_H
+#define __HASH_H
+
+// golden ratio, spreads consecutive keys over the whole word
+#define HASH_MUL 0x9E3779B97F4A7C15UL
+
+/* Slot of key in an open addressing table of capacity (a power of 2). */
+static inline long hash_slot(unsigned long key, long capacity) {
+  return ((key * HASH_MUL) >> 32) & (capacity - 1);
+}
+
+/* xorshift must not start at 0, which a seed of 0 would give it */
+static inline unsigned long seed_random(unsigned long seed) {
+  return seed ^ HASH_MUL;
+}
+
+/* xorshift64*, good enough to pick frames and schedule sources */
+static inline unsigned long next_random(unsigned long *rng) {
+  *rng ^= *rng >> 12;
+  *rng ^= *rng << 25;
+  *rng ^= *rng >> 27;
+  return *rng * 0x2545F4914F6CDD1DUL;
+}
+
+#endif  // HASH
@@ -0,0 +1,21 @@
+#ifndef __LRU_STACK_H
+#define __LRU_STACK_H
+
+/* Moves key to the top of a true LRU stack of depth entries, MRU first and
+ * 0 for an empty entry. Returns the depth key was found at, the hit an
+ * LRU set of more than that many ways gets, or -1 when it missed and the
+ * bottom entry fell off.
+ */
+static inline int lru_stack_touch(unsigned long *stack, int depth, unsigned long key) {
+  int d = 0;
+  int hit;
+
+  while (d < depth && stack[d] != key) d++;
+  hit = d < depth ? d : -1;
+  if (d == depth) d = depth - 1;
+  for (; d > 0; d--) stack[d] = stack[d - 1];
+  stack[0] = key;
+  return hit;
+}
+
+#endif  // LRU_STACK
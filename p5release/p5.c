@@ -4,6 +4,14 @@
 
 #include "print_helpers.h"
 #include "simulator.h"
+#include "stream.h"
+#include "compose.h"
+#include "sharing.h"
+#include "vmem.h"
+#include "profile.h"
+#include "trace_reader.h"
+#include "tune.h"
+#include "shared.h"
 
 int capacity;
 int block_size;
@@ -18,14 +26,53 @@ void printUsage() {
     printf("  -c|cache <cap> <bsize> <assoc>  Set the cache configuration. <cap> "
             "and <bsize> are given as the log of the value.\n");
     printf("  -p|protocol none|vi|msi         which coherence protocol\n");
-    printf("  -t|trace <tracename>            Name of trace \n");
+    printf("  -t|trace <tracename>            Name of trace, - for stdin \n");
+    printf("  -f|format native|lackey|drcachesim|champsim\n");
+    printf("                                  Encoding of the trace (default native). drcachesim\n");
+    printf("                                  and champsim are raw records, decompress them first\n");
+    printf("  -ifetch                         Also simulate instruction fetches (as loads)\n");
     printf("  -i|lru_on_invalidate            update LRU on line invalidation\n");
     printf("  -l|limit <n>                    Simulate only first n insns \n");
+    printf("  -s|stream <fifo>                Run as a daemon reading accesses from a FIFO\n");
+    printf("  -u|socket <path>                Run as a daemon accepting producers on a Unix socket\n");
+    printf("  -w|window <n>                   Publish windowed stats every n accesses (stream mode)\n");
+    printf("  -interval <sec>                 Also publish every sec seconds (stream mode)\n");
+    printf("  -m|metrics <file>               Append windowed stats to file instead of stdout\n");
+    printf("  -sharing <n>                    Analyze true/false sharing, report the n hottest blocks\n");
+    printf("  -profile text|json              Time the simulator's own pipeline stages\n");
+    printf("  -tune <miss%%>                   Find the smallest -cache settings with a lower miss rate\n");
+    printf("  -tune_range <cap_lo> <cap_hi> <bsize_lo> <bsize_hi> <max_assoc>\n");
+    printf("                                  Geometries -tune searches, logs like -cache "
+            "(default 10 21 6 6 4)\n");
+    printf("  -tune_prefix <n>                Screen on the first n accesses (default a tenth)\n");
+    printf("  -shared                         All cores share one cache of the -cache geometry\n");
+    printf("  -waymask <core> <hexmask>       Ways core may fill in the shared cache (CAT style)\n");
+    printf("  -ucp <n>                        Repartition the shared cache's ways by utility "
+            "every n accesses\n");
+    printf("  -src <trace>[,core=N][,weight=W][,offset=HEX][,format=F]\n");
+    printf("                                  Interleave this single thread trace into the run\n");
+    printf("                                  (repeatable; the k-th -src defaults to core k)\n");
+    printf("  -compose rr|weighted|burst|random\n");
+    printf("                                  How -src traces are interleaved (default rr)\n");
+    printf("  -burst <n>                      Accesses per turn in burst mode, times weight\n");
+    printf("  -seed <n>                       Seed for the random schedule and page placement\n");
+    printf("  -vm <page> seq|random|color     Translate addresses with 2^<page> B pages "
+            "(12 = 4KB, 21 = 2MB)\n");
+    printf("  -tlb <entries> <assoc>          Per core TLB geometry (default 64 4)\n");
+    printf("  -pmem <n>                       Physical memory of 2^n B (default %d)\n",
+            VMEM_DEFAULT_PMEM_BIT);
     printf("\nExamples:\n");
     printf("  shell>  ./p5 -t route.1t.short.txt -cache 9 5 1 \n");
     printf("  shell>  ./p5 -t route.1t.short.txt -cache 12 6 2 \n");
     printf("  shell>  ./p5 -t route.1t.short.txt -cache 16 4 2 \n");
     printf("  shell>  ./p5 -t route.1t.long.txt -cache 16 4 2 -limit 500\n");
+    printf("  shell>  ./p5 -n 4 -p msi -cache 12 6 2 -stream /tmp/p5.fifo -window 10000\n");
+    printf("  shell>  ./p5 -t trace.1t.long.txt -cache 20 6 8 -vm 12 color -tlb 64 4\n");
+    printf("  shell>  ./p5 -t trace.4t.short.txt -n 4 -cache 14 6 8 -shared -waymask 0 f -ucp 10000\n");
+    printf("  shell>  ./p5 -t trace.1t.long.txt -tune 5 -tune_range 10 21 4 7 8\n");
+    printf("  shell>  xz -dc 600.perlbench.xz | ./p5 -t - -f champsim -ifetch -cache 15 6 8\n");
+    printf("  shell>  ./p5 -p msi -cache 12 6 2 -compose weighted -src trace.1t.long.txt,weight=3 "
+            "-src trace.1t.short.txt,offset=40000000\n");
     printf(
             "  -cache 9 5 1   Creates a direct mapped cache "
             "with a capacity of 512B and block size of 32B \n");
@@ -120,6 +167,21 @@ int parse_args(char **args, int num_args, simulator_t *sim) {
             sim->trace = args[i++];
         }
 
+        // -format lackey
+        if (strcmp(arg, "-format") == 0 || strcmp(arg, "-f") == 0) {
+            sim->format = parse_format(args[i++]);
+            if (sim->format < 0) {
+                printf("unsupported trace format.\nExiting....\n");
+                suggest_help();
+                exit(1);
+            }
+        }
+
+        // -ifetch
+        if (strcmp(arg, "-ifetch") == 0) {
+            sim->ifetch_f = true;
+        }
+
         // -lru_on_invalidate
         if (strcmp(arg, "-lru_on_invalidate") == 0 || strcmp(arg, "-i") == 0) {
             sim->lru_on_invalidate_f = true;
@@ -130,6 +192,256 @@ int parse_args(char **args, int num_args, simulator_t *sim) {
             sim->limit_insn_f = true;
             sim->insn_limit = atoi(args[i++]);
         }
+
+        // -stream /tmp/p5.fifo
+        if (strcmp(arg, "-stream") == 0 || strcmp(arg, "-s") == 0) {
+            sim->stream_path = args[i++];
+        }
+
+        // -socket /tmp/p5.sock
+        if (strcmp(arg, "-socket") == 0 || strcmp(arg, "-u") == 0) {
+            sim->socket_path = args[i++];
+        }
+
+        // -window 100000
+        if (strcmp(arg, "-window") == 0 || strcmp(arg, "-w") == 0) {
+            sim->window = atol(args[i++]);
+            if (sim->window <= 0) {
+                printf("Window must be at least 1 access.\nExiting...\n");
+                suggest_help();
+                exit(1);
+            }
+        }
+
+        // -sharing 10
+        if (strcmp(arg, "-sharing") == 0) {
+            sim->sharing_top_n = atoi(args[i++]);
+            if (sim->sharing_top_n <= 0) {
+                printf("Sharing report needs at least 1 block.\nExiting...\n");
+                suggest_help();
+                exit(1);
+            }
+        }
+
+        // -profile text|json
+        if (strcmp(arg, "-profile") == 0) {
+            char *format = args[i++];
+            if (strcmp(format, "text") != 0 && strcmp(format, "json") != 0) {
+                printf("unsupported profile format.\nExiting....\n");
+                suggest_help();
+                exit(1);
+            }
+            sim->profile = make_profile(strcmp(format, "json") == 0);
+        }
+
+        // -tune 5.0
+        if (strcmp(arg, "-tune") == 0) {
+            double target = atof(args[i++]);
+            if (sim->tuner == NULL) sim->tuner = make_tuner(target);
+            sim->tuner->target = target;
+        }
+
+        // -tune_range 10 21 6 6 4
+        if (strcmp(arg, "-tune_range") == 0) {
+            if (i + 5 > num_args) {
+                printf("Tuning range incomplete. Capacity and block size bounds "
+                        "and the maximum associativity must be specified.\nExiting...\n");
+                suggest_help();
+                exit(1);
+            }
+            if (sim->tuner == NULL) sim->tuner = make_tuner(0);
+            sim->tuner->log_cap_lo = atoi(args[i++]);
+            sim->tuner->log_cap_hi = atoi(args[i++]);
+            sim->tuner->log_bsize_lo = atoi(args[i++]);
+            sim->tuner->log_bsize_hi = atoi(args[i++]);
+            sim->tuner->max_assoc = atoi(args[i++]);
+            tuner_t *t = sim->tuner;
+            if (t->log_cap_lo < 0 || t->log_cap_hi > 25 || t->log_cap_lo > t->log_cap_hi ||
+                    t->log_bsize_lo < 0 || t->log_bsize_hi > 25 ||
+                    t->log_bsize_lo > t->log_bsize_hi || t->max_assoc <= 0 ||
+                    (t->max_assoc & (t->max_assoc - 1)) != 0) {
+                printf("Tuning range invalid. Capacity and block size must be between "
+                        "2^0 and 2^25 and the maximum associativity a power of "
+                        "2.\nExiting...\n");
+                suggest_help();
+                exit(1);
+            }
+        }
+
+        // -tune_prefix 20000
+        if (strcmp(arg, "-tune_prefix") == 0) {
+            if (sim->tuner == NULL) sim->tuner = make_tuner(0);
+            sim->tuner->prefix = atol(args[i++]);
+        }
+
+        // -shared
+        if (strcmp(arg, "-shared") == 0) {
+            if (sim->shared == NULL) sim->shared = make_shared_cache();
+        }
+
+        // -waymask 0 f0
+        if (strcmp(arg, "-waymask") == 0) {
+            if (i + 2 > num_args) {
+                printf("Way mask incomplete. Core and mask must be specified.\nExiting...\n");
+                suggest_help();
+                exit(1);
+            }
+            if (sim->shared == NULL) sim->shared = make_shared_cache();
+            int core = atoi(args[i++]);
+            unsigned long mask = strtoul(args[i++], NULL, 16);
+            if (core < 0 || core >= SHARED_MAX_CORES || mask == 0) {
+                printf("Way mask invalid. Core must be below %d and the mask "
+                        "non-zero.\nExiting...\n", SHARED_MAX_CORES);
+                suggest_help();
+                exit(1);
+            }
+            sim->shared->way_mask[core] = mask;
+            sim->shared->masked_f = true;
+        }
+
+        // -ucp 10000
+        if (strcmp(arg, "-ucp") == 0) {
+            if (sim->shared == NULL) sim->shared = make_shared_cache();
+            sim->shared->ucp_interval = atol(args[i++]);
+            if (sim->shared->ucp_interval <= 0) {
+                printf("Repartition interval must be at least 1 access.\nExiting...\n");
+                suggest_help();
+                exit(1);
+            }
+        }
+
+        // -src trace.1t.long.txt,core=3,weight=2,offset=10000000
+        if (strcmp(arg, "-src") == 0) {
+            if (sim->composer == NULL) sim->composer = make_composer();
+            if (!parse_compose_src(sim->composer, args[i++])) {
+                printf("Invalid source trace '%s'.\nExiting...\n", args[i - 1]);
+                suggest_help();
+                exit(1);
+            }
+        }
+
+        // -compose rr|weighted|burst|random
+        if (strcmp(arg, "-compose") == 0) {
+            char *schedule = args[i++];
+            if (sim->composer == NULL) sim->composer = make_composer();
+            if (strcmp(schedule, "rr") == 0)
+                sim->composer->schedule = SCHED_RR;
+            else if (strcmp(schedule, "weighted") == 0)
+                sim->composer->schedule = SCHED_WEIGHTED;
+            else if (strcmp(schedule, "burst") == 0)
+                sim->composer->schedule = SCHED_BURST;
+            else if (strcmp(schedule, "random") == 0)
+                sim->composer->schedule = SCHED_RANDOM;
+            else {
+                printf("unsupported schedule.\nExiting....\n");
+                suggest_help();
+                exit(1);
+            }
+        }
+
+        // -burst 64
+        if (strcmp(arg, "-burst") == 0) {
+            if (sim->composer == NULL) sim->composer = make_composer();
+            sim->composer->burst = atoi(args[i++]);
+            if (sim->composer->burst <= 0) {
+                printf("Burst must be at least 1 access.\nExiting...\n");
+                suggest_help();
+                exit(1);
+            }
+        }
+
+        // -seed 42
+        if (strcmp(arg, "-seed") == 0) {
+            sim->seed = strtoul(args[i++], NULL, 10);
+        }
+
+        // -vm 12 seq|random|color
+        if (strcmp(arg, "-vm") == 0) {
+            if (i + 2 > num_args) {
+                printf("Translation description incomplete. Page size and "
+                        "allocation policy must be specified.\nExiting...\n");
+                suggest_help();
+                exit(1);
+            }
+            sim->vm_page_bit = atoi(args[i++]);
+            char *policy = args[i++];
+            if (strcmp(policy, "seq") == 0)
+                sim->vm_policy = PALLOC_SEQ;
+            else if (strcmp(policy, "random") == 0)
+                sim->vm_policy = PALLOC_RANDOM;
+            else if (strcmp(policy, "color") == 0)
+                sim->vm_policy = PALLOC_COLOR;
+            else {
+                printf("unsupported page allocation policy.\nExiting....\n");
+                suggest_help();
+                exit(1);
+            }
+        }
+
+        // -tlb 64 4
+        if (strcmp(arg, "-tlb") == 0) {
+            if (i + 2 > num_args) {
+                printf("TLB description incomplete. Entries and associativity "
+                        "must be specified.\nExiting...\n");
+                suggest_help();
+                exit(1);
+            }
+            sim->tlb_entries = atoi(args[i++]);
+            sim->tlb_assoc = atoi(args[i++]);
+            if (sim->tlb_entries <= 0 || sim->tlb_assoc <= 0 ||
+                    sim->tlb_entries % sim->tlb_assoc != 0) {
+                printf("TLB description invalid. Entries must be a non-zero "
+                        "multiple of the associativity.\nExiting...\n");
+                suggest_help();
+                exit(1);
+            }
+        }
+
+        // -pmem 32
+        if (strcmp(arg, "-pmem") == 0) {
+            sim->vm_pmem_bit = atoi(args[i++]);
+        }
+
+        // -interval 5
+        if (strcmp(arg, "-interval") == 0) {
+            sim->interval = atoi(args[i++]);
+        }
+
+        // -metrics stats.log
+        if (strcmp(arg, "-metrics") == 0 || strcmp(arg, "-m") == 0) {
+            sim->metrics_path = args[i++];
+        }
+    }
+
+    // stream lines go straight to parse_trace_line, the other decoders and
+    // the composer only sit behind the batch trace reader
+    if ((sim->stream_path || sim->socket_path) &&
+            (sim->format != FORMAT_NATIVE || sim->ifetch_f || sim->composer)) {
+        printf("Streamed traces must be in the native format. -format, -ifetch and -src "
+                "cannot be combined with -stream or -socket.\nExiting...\n");
+        suggest_help();
+        exit(1);
+    }
+
+    if (sim->tuner) {
+        if (sim->tuner->target <= 0) {
+            printf("No miss rate target specified. Please use the -tune flag\n");
+            suggest_help();
+            exit(1);
+        }
+        // the tuner replays core 0 of -t through private LRU caches it sizes
+        // itself, anything else on the command line would be ignored
+        if (cache_specified || sim->protocol != NONE || sim->lru_on_invalidate_f ||
+                sim->stream_path || sim->socket_path || sim->metrics_path ||
+                sim->sharing_top_n > 0 || sim->profile || sim->shared ||
+                sim->vm_page_bit || sim->composer) {
+            printf("The tuner reads a single trace (-t) into a private cache. -cache, -p, "
+                    "-i, -stream, -socket, -metrics, -sharing, -profile, -shared, -waymask, "
+                    "-ucp, -vm and -src cannot be combined with -tune.\nExiting...\n");
+            suggest_help();
+            exit(1);
+        }
+        return 1;  // the tuner picks the cache itself
     }
 
     if (!cache_specified) {
@@ -138,6 +450,46 @@ int parse_args(char **args, int num_args, simulator_t *sim) {
         exit(1);
     }
 
+    if (sim->vm_page_bit && (sim->vm_page_bit < 10 || sim->vm_page_bit > 30 ||
+                sim->vm_pmem_bit < sim->vm_page_bit || sim->vm_pmem_bit > VMEM_MAX_PMEM_BIT)) {
+        printf("Translation description invalid. Pages must be between 2^10 and 2^30 "
+                "and fit in physical memory of at most 2^%d.\nExiting...\n", VMEM_MAX_PMEM_BIT);
+        suggest_help();
+        exit(1);
+    }
+
+    if (sim->composer) {
+        sim->composer->seed = sim->seed;
+        if (sim->composer->n_src == 0) {
+            printf("No source traces to compose. Please use the -src flag\n");
+            suggest_help();
+            exit(1);
+        }
+        // every source needs its own core
+        if (composer_n_core(sim->composer) > sim->n_core)
+            sim->n_core = composer_n_core(sim->composer);
+    }
+
+    // one copy of every line, there is nothing to snoop or invalidate
+    if (sim->shared && (sim->protocol != NONE || sim->sharing_top_n > 0)) {
+        printf("A shared cache has no coherence. -p vi|msi and -sharing cannot be "
+                "combined with -shared.\nExiting...\n");
+        suggest_help();
+        exit(1);
+    }
+
+    // -n may come after -waymask, so the cores are only known now
+    if (sim->shared) {
+        for (int i = sim->n_core; i < SHARED_MAX_CORES; i++) {
+            if (sim->shared->way_mask[i]) {
+                printf("Way mask of core %d invalid, only %d cores are simulated."
+                        "\nExiting...\n", i, sim->n_core);
+                suggest_help();
+                exit(1);
+            }
+        }
+    }
+
     return 1;
 }
 
@@ -145,12 +497,29 @@ int main(int argc, char *argv[]) {
     simulator_t *sim = make_simulator();
 
     if (parse_args(argv, argc, sim)) {
+        if (sim->tuner) {
+            run_tuner(sim, sim->tuner);
+            return EXIT_SUCCESS;
+        }
         sim->cache = malloc(sim->n_core * sizeof(cache_t*));
+        if (sim->shared)
+            open_shared_cache(sim->shared, sim->n_core, capacity, block_size, assoc);
         for (int i = 0; i < sim->n_core; i++){
-            sim->cache[i] = make_cache(capacity, block_size, assoc, sim->protocol, sim->lru_on_invalidate_f);
+            if (sim->shared)
+                sim->cache[i] = sim->shared->views[i];
+            else
+                sim->cache[i] = make_cache(capacity, block_size, assoc, sim->protocol, sim->lru_on_invalidate_f);
         }
+        if (sim->sharing_top_n > 0)
+            sim->sharing = make_sharing(sim->n_core, block_size, sim->sharing_top_n);
+        if (sim->vm_page_bit)
+            sim->vm = make_vmem(sim->n_core, sim->vm_page_bit, sim->vm_policy, sim->vm_pmem_bit,
+                    sim->tlb_entries, sim->tlb_assoc, capacity / assoc, sim->seed);
         print_simulator_header(sim);
-        process_trace(sim);  // this is still where the action takes place
+        if (sim->stream_path || sim->socket_path)
+            process_stream(sim);
+        else
+            process_trace(sim);  // this is still where the action takes place
     }
 
     return EXIT_SUCCESS;
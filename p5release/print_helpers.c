@@ -4,6 +4,10 @@
 #include "cache_stats.h"
 #include "simulator.h"
 #include "print_helpers.h"
+#include "compose.h"
+#include "vmem.h"
+#include "trace_reader.h"
+#include "shared.h"
 
 
 /* fields you might want to have print */
@@ -19,12 +23,32 @@ void log_way(int way) {
   print_way = way;
 }
 
+int get_logged_way() {
+  return print_way;
+}
+
 
 void print_simulator_header(simulator_t *sim) {
   printf("P5 Printout for CS 3410\n");
   printf("----------------------------------\n");
 
-  printf("Trace  \t\t%s\n", sim->trace);
+  if (sim->composer) {
+    printf("Compose \t%s\n", schedule_to_str(sim->composer->schedule));
+    for (int i = 0; i < sim->composer->n_src; i++)
+      printf("  core %d \t%s (weight %d, offset %lx)\n", sim->composer->srcs[i].core,
+             sim->composer->srcs[i].name, sim->composer->srcs[i].weight,
+             sim->composer->srcs[i].offset);
+  } else if (sim->socket_path)
+    printf("Socket \t\t%s\n", sim->socket_path);
+  else if (sim->stream_path)
+    printf("Stream \t\t%s\n", sim->stream_path);
+  else
+    printf("Trace  \t\t%s\n", sim->trace);
+  if (sim->format != FORMAT_NATIVE || sim->ifetch_f)
+    printf("Format \t\t%s%s\n", format_to_str(sim->format), sim->ifetch_f ? " +ifetch" : "");
+  if (sim->vm)
+    printf("Translation \t%ld B pages, %s, %d entry %d-way TLB\n", 1L << sim->vm_page_bit,
+           palloc_to_str(sim->vm_policy), sim->tlb_entries, sim->tlb_assoc);
   printf("Instruction Limit \t");
   if (sim->limit_insn_f) {
     printf("%d\n", sim->insn_limit);
@@ -32,6 +56,10 @@ void print_simulator_header(simulator_t *sim) {
     printf("none\n");
   }
   print_cache_config(sim->cache[0]); // caches must be identical, so [0] is fine
+  if (sim->shared)
+    printf("shared by %d cores, %s\n", sim->n_core,
+           sim->shared->ucp_interval ? "utility partitioned" :
+           sim->shared->masked_f ? "way partitioned" : "unpartitioned");
 }
 
 void print_stats(cache_stats_t *stats, int core) {
@@ -9,6 +9,7 @@
 /* if you want verbose mode to work, you will need to call these 2 functions */
 void log_set(int set);
 void log_way(int way);
+int get_logged_way();
 
 void print_simulator_header(simulator_t *sim);
 
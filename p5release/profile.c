@@ -0,0 +1,114 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "profile.h"
+
+static char *stage_names[PROF_N_STAGE] = {
+  "io", "parse", "translate", "access", "snoop", "analysis", "stats"
+};
+
+profile_t *make_profile(bool json_f) {
+  profile_t *prof = calloc(1, sizeof(profile_t));
+
+  prof->json_f = json_f;
+  prof->sampled_f = false;
+
+  // reading the counter is not free and every timed window pays for it
+  // once, which on a ~100 cycle access is no rounding error
+  prof->overhead = UINT64_MAX;
+  for (int i = 0; i < 1000; i++) {
+    uint64_t start = read_cycles();
+    uint64_t cycles = read_cycles() - start;
+    if (cycles < prof->overhead) prof->overhead = cycles;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &prof->start_time);
+  prof->start_cycles = read_cycles();
+
+  return prof;
+}
+
+/* Estimated cycles of a stage over the whole run. The number of timed
+ * windows goes in n_timed and how many of them were clamped in n_clamped.
+ */
+static double stage_cycles(profile_t *prof, enum stage_t stage, long *n_timed,
+                           long *n_clamped) {
+  uint64_t *sum = prof->sampled[stage];
+  long *count = prof->n_timed_sampled[stage];
+  double scale = prof->n_sampled ? (double)prof->n_access / prof->n_sampled : 0.0;
+  long n = 0, seen = 0;
+  double median = 0, sampled = 0;
+
+  for (int b = 0; b < PROFILE_BUCKETS; b++) n += count[b];
+  // the mean of the bucket holding the middle window is close enough
+  for (int b = 0; b < PROFILE_BUCKETS && seen * 2 < n; b++) {
+    seen += count[b];
+    if (seen * 2 >= n) median = (double)sum[b] / count[b];
+  }
+
+  *n_timed = n + prof->n_timed_exact[stage];
+  *n_clamped = 0;
+  for (int b = 0; b < PROFILE_BUCKETS; b++) {
+    if (count[b] == 0) continue;
+    if ((double)sum[b] / count[b] > PROFILE_OUTLIER * median) {
+      sampled += count[b] * PROFILE_OUTLIER * median;
+      *n_clamped += count[b];
+    } else {
+      sampled += sum[b];
+    }
+  }
+
+  // each kind of window pays for its own counter reads, before any scaling
+  sampled -= (double)n * prof->overhead;
+  double exact = (double)prof->exact[stage] -
+                 (double)prof->n_timed_exact[stage] * prof->overhead;
+  return (sampled > 0 ? sampled * scale : 0) + (exact > 0 ? exact : 0);
+}
+
+void print_profile(profile_t *prof) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  double elapsed_ns = (now.tv_sec - prof->start_time.tv_sec) * 1e9 +
+                      (now.tv_nsec - prof->start_time.tv_nsec);
+  double cycles_per_ns = elapsed_ns > 0 ? (read_cycles() - prof->start_cycles) / elapsed_ns : 1.0;
+  double cycles[PROF_N_STAGE], total = 0;
+  long n_timed[PROF_N_STAGE], n_clamped[PROF_N_STAGE];
+  for (int s = 0; s < PROF_N_STAGE; s++) {
+    cycles[s] = stage_cycles(prof, s, &n_timed[s], &n_clamped[s]);
+    total += cycles[s];
+  }
+  double per_access = prof->n_access ? 1.0 / prof->n_access : 0.0;
+
+  if (prof->json_f) {
+    printf("{\"accesses\": %ld, \"sample_period\": %d, \"sampled\": %ld, "
+           "\"elapsed_ns\": %.0f, \"cycles_per_ns\": %.3f, \"stages\": {",
+           prof->n_access, PROFILE_SAMPLE, prof->n_sampled, elapsed_ns, cycles_per_ns);
+    for (int s = 0; s < PROF_N_STAGE; s++) {
+      printf("%s\"%s\": {\"cycles\": %.0f, \"share\": %.4f, \"ns_per_access\": %.3f, "
+             "\"timed\": %ld, \"clamped\": %ld}",
+             s ? ", " : "", stage_names[s], cycles[s], total > 0 ? cycles[s] / total : 0.0,
+             cycles[s] / cycles_per_ns * per_access, n_timed[s], n_clamped[s]);
+    }
+    printf("}, \"work\": {\"ways_scanned\": %ld, \"bus_events\": %ld, \"snoops\": %ld, "
+           "\"ways_per_access\": %.3f, \"snoops_per_access\": %.3f}}\n",
+           prof->n_ways_scanned, prof->n_bus_events, prof->n_snoops,
+           prof->n_ways_scanned * per_access, prof->n_snoops * per_access);
+    return;
+  }
+
+  printf("    *** Profile ***\n");
+  printf("profile.n_accesses \t%ld\n", prof->n_access);
+  printf("profile.sample_period \t%d\n", PROFILE_SAMPLE);
+  printf("profile.elapsed_ms \t%.3f\n", elapsed_ns / 1e6);
+  printf("profile.cycles_per_ns \t%.3f\n", cycles_per_ns);
+  printf("stage       \t      cycles \t share \tns/access \t   timed \tclamped\n");
+  for (int s = 0; s < PROF_N_STAGE; s++) {
+    printf("%-10s \t%12.0f \t%5.1f%% \t%8.2f \t%8ld \t%7ld\n", stage_names[s], cycles[s],
+           total > 0 ? 100.0 * cycles[s] / total : 0.0, cycles[s] / cycles_per_ns * per_access,
+           n_timed[s], n_clamped[s]);
+  }
+  printf("profile.ways_per_access \t%.3f\n", prof->n_ways_scanned * per_access);
+  printf("profile.bus_events \t\t%ld\n", prof->n_bus_events);
+  printf("profile.snoops_per_access \t%.3f\n", prof->n_snoops * per_access);
+}
@@ -0,0 +1,93 @@
+#ifndef __PROFILE_H
+#define __PROFILE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// time one access in every PROFILE_SAMPLE (a power of 2) and scale up,
+// reading the cycle counter on every access would cost more than a hit
+#define PROFILE_SAMPLE 64
+
+// timed windows are kept as a log2 histogram per stage. a window more than
+// PROFILE_OUTLIER times the stage's median was preempted or faulted, and
+// scaled by PROFILE_SAMPLE it would swamp the stage, so it is clamped
+#define PROFILE_BUCKETS 48
+#define PROFILE_OUTLIER 16
+
+// the pipeline stages an access goes through
+enum stage_t { PROF_IO, PROF_PARSE, PROF_TRANSLATE, PROF_ACCESS, PROF_SNOOP,
+               PROF_ANALYSIS, PROF_STATS, PROF_N_STAGE };
+
+typedef struct profile_s {
+  bool json_f;             // print the report as JSON instead of text
+  bool sampled_f;          // is the current access being timed?
+
+  long n_access;
+  long n_sampled;
+  // cycles of the timed accesses only, by window length
+  uint64_t sampled[PROF_N_STAGE][PROFILE_BUCKETS];
+  long n_timed_sampled[PROF_N_STAGE][PROFILE_BUCKETS];
+  uint64_t exact[PROF_N_STAGE];        // cycles of once-per-batch work, not scaled
+  long n_timed_exact[PROF_N_STAGE];
+  uint64_t overhead;                   // cycles one start/stop pair adds by itself
+
+  // work per access, counted on every access
+  long n_ways_scanned;
+  long n_bus_events;       // misses the requesting core put on the bus
+  long n_snoops;           // caches that had to look at a bus event
+
+  uint64_t start_cycles;   // to convert cycles into time at the end
+  struct timespec start_time;
+} profile_t;
+
+static inline uint64_t read_cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+#endif
+}
+
+/* Call once per access before its first stage, decides if it gets timed. */
+static inline void profile_next(profile_t *prof) {
+  if (prof == NULL) return;
+  prof->sampled_f = (prof->n_access++ & (PROFILE_SAMPLE - 1)) == 0;
+  if (prof->sampled_f) prof->n_sampled++;
+}
+
+static inline uint64_t profile_start(profile_t *prof) {
+  return (prof && prof->sampled_f) ? read_cycles() : 0;
+}
+
+static inline void profile_stop(profile_t *prof, enum stage_t stage, uint64_t start) {
+  if (prof && prof->sampled_f) {
+    uint64_t cycles = read_cycles() - start;
+    int bucket = cycles ? 63 - __builtin_clzll(cycles) : 0;
+    if (bucket >= PROFILE_BUCKETS) bucket = PROFILE_BUCKETS - 1;
+    prof->sampled[stage][bucket] += cycles;
+    prof->n_timed_sampled[stage][bucket]++;
+  }
+}
+
+/* for work done once per batch or once per run, always timed */
+static inline uint64_t profile_start_exact(profile_t *prof) {
+  return prof ? read_cycles() : 0;
+}
+
+static inline void profile_stop_exact(profile_t *prof, enum stage_t stage, uint64_t start) {
+  if (prof) {
+    prof->exact[stage] += read_cycles() - start;
+    prof->n_timed_exact[stage]++;
+  }
+}
+
+profile_t *make_profile(bool json_f);
+void print_profile(profile_t *prof);
+
+#endif  // PROFILE
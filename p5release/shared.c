@@ -0,0 +1,212 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "shared.h"
+#include "print_helpers.h"
+#include "lru_stack.h"
+
+shared_cache_t *make_shared_cache() {
+  shared_cache_t *shared = malloc(sizeof(shared_cache_t));
+
+  shared->n_core = 0;
+  shared->cache = NULL;
+  shared->views = NULL;
+
+  memset(shared->way_mask, 0, sizeof(shared->way_mask));
+  shared->masked_f = false;
+
+  shared->ucp_interval = 0;
+  shared->n_since_repartition = 0;
+  shared->n_repartition = 0;
+
+  return shared;
+}
+
+void open_shared_cache(shared_cache_t *shared, int n_core, int capacity, int block_size,
+                       int assoc) {
+  if (n_core > SHARED_MAX_CORES) {
+    printf("ERROR: a shared cache supports at most %d cores!\n", SHARED_MAX_CORES);
+    exit(EXIT_FAILURE);
+  }
+  if ((shared->masked_f || shared->ucp_interval) && assoc > 64) {
+    printf("ERROR: way partitioning supports at most 64 ways!\n");
+    exit(EXIT_FAILURE);
+  }
+  if (shared->ucp_interval && n_core > assoc) {
+    printf("ERROR: utility based partitioning needs at least one way per core!\n");
+    exit(EXIT_FAILURE);
+  }
+
+  shared->n_core = n_core;
+  // no other copies, so nothing to be coherent with
+  shared->cache = make_cache(capacity, block_size, assoc, NONE, false);
+  shared->views = malloc(n_core * sizeof(cache_t *));
+  for (int i = 0; i < n_core; i++) {
+    shared->views[i] = malloc(sizeof(cache_t));
+    *shared->views[i] = *shared->cache;
+    shared->views[i]->stats = make_cache_stats();
+  }
+
+  shared->owner = malloc(shared->cache->n_cache_line * sizeof(int));
+  for (int i = 0; i < shared->cache->n_cache_line; i++) shared->owner[i] = -1;
+  shared->occupancy = calloc(n_core, sizeof(long));
+  shared->n_stolen = calloc(n_core, sizeof(long));
+
+  int n_umon = shared->cache->n_set < UMON_SETS ? shared->cache->n_set : UMON_SETS;
+  shared->umon_stride = shared->cache->n_set / n_umon;
+  shared->umon_tags = calloc((long)n_core * UMON_SETS * assoc, sizeof(unsigned long));
+  shared->umon_hits = calloc((long)n_core * assoc, sizeof(long));
+
+  for (int i = 0; i < n_core; i++) {
+    unsigned long mask = shared->way_mask[i];
+    if (assoc < 64) mask &= (1UL << assoc) - 1;
+    if (shared->way_mask[i] && mask == 0) {
+      printf("ERROR: way mask of core %d has no way of a %d-way cache!\n", i, assoc);
+      exit(EXIT_FAILURE);
+    }
+    shared->way_mask[i] = mask;
+  }
+}
+
+/* Shadow LRU tags of a sampled set: counts the hit at its stack position,
+ * i.e. the hit the core gets only if it owns at least that many ways.
+ */
+static void umon_access(shared_cache_t *shared, int core, int index, unsigned long tag) {
+  if (index % shared->umon_stride != 0) return;
+
+  int assoc = shared->cache->assoc;
+  unsigned long key = tag + 1;
+  unsigned long *stack = &shared->umon_tags[((long)core * UMON_SETS +
+                                             index / shared->umon_stride) * assoc];
+  int d = lru_stack_touch(stack, assoc, key);
+
+  if (d >= 0) shared->umon_hits[core * assoc + d]++;
+}
+
+/* Lookahead allocation: every core keeps one way, the rest go one grant at
+ * a time to the core with the most extra hits per extra way.
+ */
+static void repartition(shared_cache_t *shared) {
+  int assoc = shared->cache->assoc;
+  int n = shared->n_core;
+  int *alloc = malloc(n * sizeof(int));
+  int balance = assoc - n;
+
+  for (int c = 0; c < n; c++) alloc[c] = 1;
+
+  while (balance > 0) {
+    int best_core = -1;
+    int best_k = 1;
+    double best_mu = -1;
+    for (int c = 0; c < n; c++) {
+      long gain = 0;
+      for (int k = 1; k <= balance; k++) {
+        gain += shared->umon_hits[c * assoc + alloc[c] + k - 1];
+        double mu = (double)gain / k;
+        // on a tie the core with fewer ways wins, so no data splits evenly
+        if (mu > best_mu || (mu == best_mu && alloc[c] < alloc[best_core])) {
+          best_mu = mu;
+          best_core = c;
+          best_k = k;
+        }
+      }
+    }
+    alloc[best_core] += best_k;
+    balance -= best_k;
+  }
+
+  int way = 0;
+  for (int c = 0; c < n; c++) {
+    unsigned long mask = alloc[c] >= 64 ? ~0UL : (1UL << alloc[c]) - 1;
+    shared->way_mask[c] = mask << way;
+    way += alloc[c];
+  }
+  shared->masked_f = true;
+
+  // halve the counters so the next interval can change our mind
+  for (long i = 0; i < (long)n * assoc; i++) shared->umon_hits[i] /= 2;
+
+  free(alloc);
+  shared->n_repartition++;
+}
+
+/* first way from the set's LRU pointer on that core may fill */
+static int pick_victim(shared_cache_t *shared, int core, int index) {
+  int assoc = shared->cache->assoc;
+  int start = shared->cache->lru_way[index];
+  unsigned long mask = shared->way_mask[core];
+
+  for (int k = 0; k < assoc; k++) {
+    int way = (start + k) % assoc;
+    if (mask == 0 || ((mask >> way) & 1)) return way;
+  }
+  return start;
+}
+
+/* Like access_cache without coherence, but the fill is restricted to the
+ * core's ways and the stats go to the core's view.
+ */
+bool access_shared_cache(shared_cache_t *shared, int core, unsigned long addr,
+                         enum action_t action) {
+  cache_t *cache = shared->cache;
+  cache_stats_t *stats = shared->views[core]->stats;
+  int index = get_cache_index(cache, addr);
+  unsigned long tag = get_cache_tag(cache, addr);
+  cache_line_t *set = cache->lines[index];
+  int *lru = cache->lru_way;
+  bool wb = false;
+
+  if (shared->ucp_interval) {
+    umon_access(shared, core, index, tag);
+    if (++shared->n_since_repartition == shared->ucp_interval) {
+      shared->n_since_repartition = 0;
+      repartition(shared);
+    }
+  }
+
+  for (int i = 0; i < cache->assoc; i++) {
+    if (set[i].tag == tag && set[i].state == VALID) {
+      log_way(i);
+      log_set(index);
+      if (action == STORE) set[i].dirty_f = true;
+      lru[index] = (i + 1) % cache->assoc;
+      update_stats(stats, true, false, false, action);
+      return true;
+    }
+  }
+
+  int victim = pick_victim(shared, core, index);
+  int *owner = &shared->owner[index * cache->assoc + victim];
+  if (set[victim].state == VALID) {
+    if (set[victim].dirty_f == true) wb = true;
+    shared->occupancy[*owner]--;
+    if (*owner != core) shared->n_stolen[*owner]++;
+  }
+  log_way(victim);
+  log_set(index);
+  set[victim].tag = tag;
+  set[victim].dirty_f = (action == STORE);
+  set[victim].state = VALID;
+  *owner = core;
+  shared->occupancy[core]++;
+  update_stats(stats, false, wb, false, action);
+  lru[index] = (victim + 1) % cache->assoc;
+  return false;
+}
+
+void print_shared_cache(shared_cache_t *shared) {
+  printf("    *** Shared Cache ***\n");
+  printf("shared.n_repartitions \t%ld\n", shared->n_repartition);
+  for (int i = 0; i < shared->n_core; i++) {
+    if (shared->way_mask[i])
+      printf("%d.way_mask \t\t%lx\n", i, shared->way_mask[i]);
+    else
+      printf("%d.way_mask \t\tall\n", i);
+    printf("%d.occupancy \t\t%ld\n", i, shared->occupancy[i]);
+    printf("%d.occupancy_rate \t%.2f\n", i,
+           100.0 * shared->occupancy[i] / shared->cache->n_cache_line);
+    printf("%d.n_lines_stolen \t%ld\n", i, shared->n_stolen[i]);
+  }
+}
@@ -0,0 +1,46 @@
+#ifndef __SHARED_H
+#define __SHARED_H
+
+#include <stdbool.h>
+#include "cache.h"
+#include "cache_stats.h"
+
+#define SHARED_MAX_CORES 256
+// sets the utility monitors shadow, per core
+#define UMON_SETS 32
+
+/* One cache shared by all cores, e.g. a last level cache. Each core still
+ * gets its own cache_t, but those are views: they share the lines and the
+ * LRU pointers of the one cache and only have their own stats.
+ */
+typedef struct shared_cache_s {
+  int n_core;
+  cache_t *cache;            // the lines everyone uses
+  cache_t **views;           // per core, same lines with the core's stats
+
+  // way partitioning: a core hits in any way but only fills its own
+  unsigned long way_mask[SHARED_MAX_CORES];  // 0 = every way
+  bool masked_f;
+
+  int *owner;                // [set * assoc + way] core that filled it, -1 if none
+  long *occupancy;           // per core, lines it owns right now
+  long *n_stolen;            // per core, its lines evicted by another core
+
+  // utility based partitioning: every ucp_interval accesses the ways are
+  // handed out by how many extra hits each core's shadow tags saw per way
+  long ucp_interval;         // 0 = off
+  long n_since_repartition;
+  long n_repartition;
+  int umon_stride;           // shadow one set in umon_stride
+  unsigned long *umon_tags;  // [core][UMON_SETS][assoc], MRU first, 0 = empty
+  long *umon_hits;           // [core][assoc] hits at each LRU position
+} shared_cache_t;
+
+shared_cache_t *make_shared_cache();
+void open_shared_cache(shared_cache_t *shared, int n_core, int capacity, int block_size,
+                       int assoc);
+bool access_shared_cache(shared_cache_t *shared, int core, unsigned long addr,
+                         enum action_t action);
+void print_shared_cache(shared_cache_t *shared);
+
+#endif  // SHARED
@@ -0,0 +1,233 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "sharing.h"
+#include "hash.h"
+
+#define SHARING_INITIAL_CAPACITY 4096
+
+sharing_t *make_sharing(int n_core, int block_size, int top_n) {
+  sharing_t *sharing = malloc(sizeof(sharing_t));
+
+  sharing->n_core = n_core;
+  sharing->block_size = block_size;
+  sharing->n_offset_bit = 0;
+  while ((1 << sharing->n_offset_bit) < block_size) sharing->n_offset_bit++;
+  sharing->chunk_size = block_size > SHARING_CHUNKS ? block_size / SHARING_CHUNKS : 1;
+  sharing->top_n = top_n;
+
+  sharing->capacity = SHARING_INITIAL_CAPACITY;
+  sharing->table = calloc(sharing->capacity, sizeof(sharing_entry_t));
+  sharing->live = calloc(sharing->capacity * n_core, sizeof(uint64_t));
+  sharing->read = calloc(sharing->capacity * n_core, sizeof(uint64_t));
+  sharing->written = calloc(sharing->capacity * n_core, sizeof(uint64_t));
+  sharing->n_block = 0;
+  sharing->last_slot = 0;
+
+  sharing->n_inval = 0;
+  sharing->n_true = 0;
+  sharing->n_false = 0;
+  for (int k = 0; k < SHARING_N_SPLIT; k++) sharing->n_split_inval[k] = 0;
+
+  return sharing;
+}
+
+static void grow_table(sharing_t *sharing) {
+  sharing_entry_t *old_table = sharing->table;
+  uint64_t *old_live = sharing->live;
+  uint64_t *old_read = sharing->read;
+  uint64_t *old_written = sharing->written;
+  long old_capacity = sharing->capacity;
+  int n = sharing->n_core;
+
+  sharing->capacity *= 2;
+  sharing->table = calloc(sharing->capacity, sizeof(sharing_entry_t));
+  sharing->live = calloc(sharing->capacity * n, sizeof(uint64_t));
+  sharing->read = calloc(sharing->capacity * n, sizeof(uint64_t));
+  sharing->written = calloc(sharing->capacity * n, sizeof(uint64_t));
+
+  for (long i = 0; i < old_capacity; i++) {
+    if (old_table[i].key == 0) continue;
+    long slot = hash_slot(old_table[i].key, sharing->capacity);
+    while (sharing->table[slot].key != 0) slot = (slot + 1) & (sharing->capacity - 1);
+    sharing->table[slot] = old_table[i];
+    memcpy(&sharing->live[slot * n], &old_live[i * n], n * sizeof(uint64_t));
+    memcpy(&sharing->read[slot * n], &old_read[i * n], n * sizeof(uint64_t));
+    memcpy(&sharing->written[slot * n], &old_written[i * n], n * sizeof(uint64_t));
+  }
+
+  free(old_table);
+  free(old_live);
+  free(old_read);
+  free(old_written);
+}
+
+/* Returns the slot of the block holding addr, adding it if it is new. */
+static long find_slot(sharing_t *sharing, unsigned long addr) {
+  unsigned long key = (addr >> sharing->n_offset_bit) + 1;
+  long slot = hash_slot(key, sharing->capacity);
+
+  while (sharing->table[slot].key != key) {
+    if (sharing->table[slot].key == 0) {
+      // keep the load factor under 1/2 so probes stay short
+      if (2 * (sharing->n_block + 1) > sharing->capacity) {
+        grow_table(sharing);
+        return find_slot(sharing, addr);
+      }
+      sharing->table[slot].key = key;
+      sharing->n_block++;
+      break;
+    }
+    slot = (slot + 1) & (sharing->capacity - 1);
+  }
+  return slot;
+}
+
+/* chunks of the block covered by the bytes acc touches */
+static uint64_t access_mask(sharing_t *sharing, access_t *acc) {
+  int offset = acc->address & (sharing->block_size - 1);
+  int size = acc->size ? acc->size : SHARING_DEFAULT_SIZE;
+  int end = offset + size > sharing->block_size ? sharing->block_size : offset + size;
+  int first = offset / sharing->chunk_size;
+  int n = (end - 1) / sharing->chunk_size - first + 1;
+
+  if (n >= 64) return ~0UL;
+  return ((1UL << n) - 1) << first;
+}
+
+/* one bit per group of `group` chunks, set if any chunk in it is */
+static uint64_t fold_mask(uint64_t mask, int group) {
+  uint64_t folded = 0;
+  uint64_t group_mask = group >= 64 ? ~0UL : (1UL << group) - 1;
+
+  for (int j = 0; j * group < 64; j++) {
+    if ((mask >> (j * group)) & group_mask) folded |= 1UL << j;
+  }
+  return folded;
+}
+
+void sharing_access(sharing_t *sharing, access_t *acc, bool hit_f) {
+  long slot = find_slot(sharing, acc->address);
+  long i = slot * sharing->n_core + acc->core;
+  uint64_t mask = access_mask(sharing, acc);
+
+  sharing->table[slot].n_access++;
+  // a miss means the core just (re)filled its copy
+  sharing->live[i] = hit_f ? sharing->live[i] | mask : mask;
+  if (acc->action == LOAD)
+    sharing->read[i] |= mask;
+  else
+    sharing->written[i] |= mask;
+
+  sharing->last_slot = slot;
+}
+
+void sharing_invalidate(sharing_t *sharing, int victim, access_t *acc) {
+  long slot = sharing->last_slot;
+  sharing_entry_t *entry = &sharing->table[slot];
+  uint64_t *live = &sharing->live[slot * sharing->n_core + victim];
+  uint64_t mask = access_mask(sharing, acc);
+
+  entry->n_inval++;
+  sharing->n_inval++;
+
+  // true sharing if the victim used any of the bytes being written,
+  // otherwise it only lost its copy because they share a block
+  if (*live & mask) {
+    entry->n_true++;
+    sharing->n_true++;
+  } else {
+    entry->n_false++;
+    sharing->n_false++;
+  }
+
+  // would the two footprints still share a block at B/2, B/4, ...?
+  for (int k = 0; k < SHARING_N_SPLIT; k++) {
+    int group = (sharing->block_size >> (k + 1)) / sharing->chunk_size;
+    if (group == 0) break;
+    if (fold_mask(*live, group) & fold_mask(mask, group)) sharing->n_split_inval[k]++;
+  }
+
+  *live = 0;
+}
+
+static int compare_inval(const void *a, const void *b) {
+  const sharing_entry_t *x = *(const sharing_entry_t **)a;
+  const sharing_entry_t *y = *(const sharing_entry_t **)b;
+  if (x->n_inval != y->n_inval) return x->n_inval < y->n_inval ? 1 : -1;
+  return x->key < y->key ? -1 : x->key > y->key;
+}
+
+/* prints a chunk mask as byte ranges, e.g. 0-3,16-31 */
+static void print_ranges(sharing_t *sharing, uint64_t mask) {
+  bool first = true;
+  for (int i = 0; i < 64; i++) {
+    if (!((mask >> i) & 1)) continue;
+    int j = i;
+    while (j + 1 < 64 && ((mask >> (j + 1)) & 1)) j++;
+    printf("%s%d-%d", first ? "" : ",", i * sharing->chunk_size,
+           (j + 1) * sharing->chunk_size - 1);
+    first = false;
+    i = j;
+  }
+}
+
+void print_sharing(sharing_t *sharing) {
+  int n = sharing->n_core;
+  long n_shared = 0;
+  long n_hot = 0;
+  sharing_entry_t **hot = malloc(sharing->n_block * sizeof(sharing_entry_t *));
+
+  for (long s = 0; s < sharing->capacity; s++) {
+    if (sharing->table[s].key == 0) continue;
+    int n_sharer = 0;
+    for (int c = 0; c < n; c++) {
+      if (sharing->read[s * n + c] | sharing->written[s * n + c]) n_sharer++;
+    }
+    if (n_sharer > 1) n_shared++;
+    if (sharing->table[s].n_inval > 0) hot[n_hot++] = &sharing->table[s];
+  }
+  qsort(hot, n_hot, sizeof(sharing_entry_t *), compare_inval);
+
+  printf("    *** Sharing Analysis ***\n");
+  printf("sharing.n_blocks \t\t%ld\n", sharing->n_block);
+  printf("sharing.n_shared_blocks \t%ld\n", n_shared);
+  printf("sharing.n_invalidations \t%ld\n", sharing->n_inval);
+  printf("sharing.n_true_sharing \t\t%ld\n", sharing->n_true);
+  printf("sharing.n_false_sharing \t%ld\n", sharing->n_false);
+  printf("sharing.false_sharing_rate \t%.2f\n",
+         sharing->n_inval ? 100.0 * sharing->n_false / sharing->n_inval : 0.0);
+
+  // every invalidation costs the victim a refetch of the whole block
+  printf("Coherence Traffic Estimate:\n");
+  printf("sharing.B_refetch_%d \t\t%ld\n", sharing->block_size,
+         sharing->n_inval * sharing->block_size);
+  for (int k = 0; k < SHARING_N_SPLIT; k++) {
+    int split = sharing->block_size >> (k + 1);
+    if (split / sharing->chunk_size == 0) break;
+    printf("sharing.B_refetch_%d \t\t%ld\n", split, sharing->n_split_inval[k] * split);
+  }
+  printf("sharing.B_refetch_padded \t%ld\n", sharing->n_true * sharing->block_size);
+
+  printf("Top %d ping-pong blocks:\n", sharing->top_n);
+  for (long i = 0; i < n_hot && i < sharing->top_n; i++) {
+    long s = hot[i] - sharing->table;
+    printf("  blk %lx  inval %ld  true %ld  false %ld  accesses %ld\n",
+           (hot[i]->key - 1) << sharing->n_offset_bit, hot[i]->n_inval,
+           hot[i]->n_true, hot[i]->n_false, hot[i]->n_access);
+    for (int c = 0; c < n; c++) {
+      uint64_t r = sharing->read[s * n + c];
+      uint64_t w = sharing->written[s * n + c];
+      if (!(r | w)) continue;
+      printf("    core %d  r[", c);
+      print_ranges(sharing, r);
+      printf("]  w[");
+      print_ranges(sharing, w);
+      printf("]\n");
+    }
+  }
+
+  free(hot);
+}
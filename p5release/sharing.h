@@ -0,0 +1,59 @@
+#ifndef __SHARING_H
+#define __SHARING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "simulator.h"
+
+// within a block we track which bytes each core touched in at most
+// 64 chunks, so a block's footprint per core is a single uint64_t
+#define SHARING_CHUNKS 64
+// accesses whose size the trace does not give are taken to be a word
+#define SHARING_DEFAULT_SIZE 4
+// smaller block sizes (B/2, B/4, ...) to estimate coherence traffic for
+#define SHARING_N_SPLIT 3
+
+typedef struct {
+  unsigned long key;     // block address + 1, 0 marks an empty slot
+  long n_access;
+  long n_inval;
+  long n_true;
+  long n_false;
+} sharing_entry_t;
+
+typedef struct sharing_s {
+  int n_core;
+  int block_size;
+  int n_offset_bit;
+  int chunk_size;        // bytes per mask bit
+  int top_n;
+
+  // open addressing hash table keyed by block address.
+  // the masks of slot s for core c live at [s * n_core + c]
+  sharing_entry_t *table;
+  uint64_t *live;        // bytes touched since the core's copy was filled
+  uint64_t *read;        // bytes ever read, for the report
+  uint64_t *written;     // bytes ever written, for the report
+  long capacity;         // always a power of 2
+  long n_block;
+  long last_slot;        // slot of the last access, the one snoops refer to
+
+  long n_inval;
+  long n_true;
+  long n_false;
+  long n_split_inval[SHARING_N_SPLIT];  // invalidations left at block_size >> (k+1)
+} sharing_t;
+
+sharing_t *make_sharing(int n_core, int block_size, int top_n);
+
+/* Records that acc ran on its core's cache (hit_f says if it hit). */
+void sharing_access(sharing_t *sharing, access_t *acc, bool hit_f);
+
+/* Records that the bus event caused by acc invalidated victim's copy.
+ * Must follow the sharing_access call for the same acc.
+ */
+void sharing_invalidate(sharing_t *sharing, int victim, access_t *acc);
+
+void print_sharing(sharing_t *sharing);
+
+#endif  // SHARING
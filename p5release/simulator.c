@@ -5,6 +5,12 @@
 
 #include "simulator.h"
 #include "print_helpers.h"
+#include "compose.h"
+#include "sharing.h"
+#include "vmem.h"
+#include "profile.h"
+#include "trace_reader.h"
+#include "shared.h"
 
 simulator_t *make_simulator() {
     simulator_t *sim = malloc(sizeof(simulator_t));
@@ -17,82 +23,221 @@ simulator_t *make_simulator() {
 
     sim->n_core = 1;
     sim->protocol = NONE;
+    sim->shared = NULL;
 
     sim->lru_on_invalidate_f = false;
 
+    sim->composer = NULL;
+    sim->sharing = NULL;
+    sim->sharing_top_n = 0;
+
+    sim->vm = NULL;
+    sim->vm_page_bit = 0;
+    sim->vm_policy = PALLOC_SEQ;
+    sim->vm_pmem_bit = VMEM_DEFAULT_PMEM_BIT;
+    sim->tlb_entries = 64;
+    sim->tlb_assoc = 4;
+
+    sim->format = FORMAT_NATIVE;
+    sim->ifetch_f = false;
+
+    sim->seed = 1;
+    sim->profile = NULL;
+    sim->tuner = NULL;
+
+    sim->stream_path = NULL;
+    sim->socket_path = NULL;
+    sim->metrics_path = NULL;
+    sim->window = 100000;
+    sim->interval = 0;
+
     return sim;
 }
 
+/*
+ * Opens a trace by name from the trace/ directory, exits if it is missing.
+ * "-" reads the trace from stdin, e.g. piped from xz -dc.
+ */
+FILE *open_trace(char *name) {
+    if (strcmp(name, "-") == 0) return stdin;
+
+    char *path = malloc(strlen(name) + 7);
+    strncpy(path, "trace/", 7);
+    strcat(path, name);
+    FILE *trace = fopen(path, "r");
+    free(path);
+    if (trace == NULL) {
+        printf("File \'%s\' not found\n", name);
+        exit(EXIT_FAILURE);
+    }
+    return trace;
+}
+
+/*
+ * Decodes one "<core> <r|w> <hexaddr>" trace line into acc.
+ * The core id may have any number of digits.
+ * Returns false if the line is not a well formed access.
+ */
+bool parse_trace_line(simulator_t *sim, char *line, access_t *acc) {
+    char *p = line;
+    int core = 0;
+
+    if (*p < '0' || *p > '9') return false;
+    while (*p >= '0' && *p <= '9') core = core * 10 + (*p++ - '0');
+    if (p[0] != ' ' || (p[1] != 'r' && p[1] != 'w') || p[2] != ' ')
+        return false;
+
+    acc->core = core;
+    acc->action = (p[1] == 'r') ? LOAD : STORE;
+    acc->address = strtoul(&p[3], NULL, 16);
+    acc->size = 0;
+    return true;
+}
+
+/*
+ * Runs a single access on the requesting core's cache and, if it
+ * misses, broadcasts it on the bus to every other core.
+ * Returns whether the requesting core hit.
+ */
+bool simulate_access(simulator_t *sim, access_t *acc) {
+    int i;
+    int core = acc->core;
+    profile_t *prof = sim->profile;
+    uint64_t t;
+
+    // physically indexed caches: everything below sees the physical address
+    if (sim->vm) {
+        t = profile_start(prof);
+        acc->address = translate(sim->vm, core, acc->address);
+        profile_stop(prof, PROF_TRANSLATE, t);
+    }
+
+    // access the cache
+    t = profile_start(prof);
+    bool hit_f = sim->shared ? access_shared_cache(sim->shared, core, acc->address, acc->action)
+                             : access_cache(sim->cache[core], acc->address, acc->action);
+    profile_stop(prof, PROF_ACCESS, t);
+
+    // prints the insn
+    if (sim->verbose_f)
+        print_insn_info(sim, core, (acc->action == LOAD) ? 'r' : 'w', acc->address, hit_f);
+
+    if (sim->sharing) {
+        t = profile_start(prof);
+        sharing_access(sim->sharing, acc, hit_f);
+        profile_stop(prof, PROF_ANALYSIS, t);
+    }
+
+    if (prof) {
+        // a hit stops at its way, a miss looks at all of them
+        prof->n_ways_scanned += hit_f ? get_logged_way() + 1 : sim->cache[core]->assoc;
+        if (!hit_f && !sim->shared) {
+            prof->n_bus_events++;
+            prof->n_snoops += sim->n_core - 1;
+            prof->n_ways_scanned += (sim->n_core - 1) * sim->cache[core]->assoc;
+        }
+    }
+
+    // misses go on the bus
+    // (LOAD --> LD_MISS, STORE --> ST_MISS)
+    // a shared cache holds the only copy, nobody to snoop
+    if (!hit_f && !sim->shared) { 
+        t = profile_start(prof);
+        enum action_t snoop = (acc->action == LOAD) ? LD_MISS : ST_MISS;
+        for (i = 0; i < sim->n_core; i++){ // 1 core? does nothing
+            if (i != core) {
+                bool snoop_hit_f = access_cache(sim->cache[i], acc->address, snoop);
+                // VI drops the line on any bus event, MSI only on a write
+                if (sim->sharing && snoop_hit_f &&
+                        (sim->protocol == VI || (sim->protocol == MSI && snoop == ST_MISS)))
+                    sharing_invalidate(sim->sharing, i, acc);
+            }  
+        }
+        profile_stop(prof, PROF_SNOOP, t);
+    }
+    return hit_f;
+}
+
+/*
+ * Computes and prints the final statistics of every core.
+ */
+void print_results(simulator_t *sim) {
+    int i;
+    uint64_t t = profile_start_exact(sim->profile);
+
+    // compute cache statistics
+    for (i = 0; i < sim->n_core; i++){
+        calculate_stat_rates(sim->cache[i]->stats, sim->cache[i]->block_size);  
+        printf("    *** Results for Core %d ***\n", i);
+        print_stats(sim->cache[i]->stats, i);
+    }
+
+    if (sim->shared) print_shared_cache(sim->shared);
+    if (sim->sharing) print_sharing(sim->sharing);
+    if (sim->vm) print_vmem(sim->vm);
+
+    if (sim->profile) {
+        profile_stop_exact(sim->profile, PROF_STATS, t);
+        print_profile(sim->profile);
+    }
+}
+
 /*
  * Goes through the trace line by line (i.e., instruction by
  * instruction) and simulates the program being executed on a
  * multicore processor.
  */
 void process_trace(simulator_t *sim) {
-    int i;
-    char *line = NULL;
+    trace_reader_t *reader = NULL;
+    access_t acc;
+    profile_t *prof = sim->profile;
+    uint64_t t;
     // Program Stats
     long total_insn = 0;
 
     printf("Processing trace...\n");
     printf("%d %d\n", sim->n_core, sim->protocol);
 
-    char *path = malloc(strlen(sim->trace) + 7);
-    strncpy(path, "trace/", 7);
-    strcat(path, sim->trace);
-    FILE *trace = fopen(path, "r");
-    if (trace == NULL) {
-        printf("File \'%s\' not found\n", sim->trace);
-        exit(EXIT_FAILURE);
-    }
-    size_t len = 0;
-    size_t read;
+    if (sim->composer)
+        open_composer(sim->composer, sim);
+    else
+        reader = make_trace_reader(open_trace(sim->trace), sim->format,
+                sim->cache[0]->block_size, sim->ifetch_f, prof);
+
+    for (;;) {
+        // the access is not counted until it has been read, so the decode
+        // window goes with the sampling decision of the access before it
+        uint64_t io = prof ? prof->exact[PROF_IO] : 0;
+        t = profile_start(prof);
+        // the merged trace is never materialized, one access at a time
+        bool more_f = sim->composer ? compose_next(sim->composer, &acc)
+                                    : trace_reader_next(reader, &acc);
+        // refills inside the call are already counted, unscaled, as io.
+        // leave them out of the sampled window so only decoding is left
+        if (prof) t += prof->exact[PROF_IO] - io;
+        profile_stop(prof, PROF_PARSE, t);
+        if (!more_f) break;
 
-    while ((read = getline(&line, &len, trace)) != -1) {
         if (sim->limit_insn_f && total_insn == sim->insn_limit) {
             printf("Reached insn limit of %d. Ending Simulation...\n",
                     sim->insn_limit);
             break;
         }
 
-        int core = line[0]-'0'; // turn the '0' into a 0
-        if (core > (sim->n_core - 1)) {
-            printf("ERROR: this trace requires atleast %d cores!\n", core + 1);
+        if (acc.core > (sim->n_core - 1)) {
+            printf("ERROR: this trace requires atleast %d cores!\n", acc.core + 1);
             exit(EXIT_FAILURE);
         }
 
-        enum action_t action = (line[2] == 'r') ? LOAD : STORE;
-        unsigned long address = strtol(&line[4], NULL, 16);
-
         total_insn++;
 
-        // access the cache
-        bool hit_f = access_cache(sim->cache[core], address, action);
-
-        // prints the insn
-        if (sim->verbose_f) print_insn_info(sim, core, line[2], address, hit_f);
-
-        // misses go on the bus
-        // (LOAD --> LD_MISS, STORE --> ST_MISS)
-        if (!hit_f) { 
-            for (i = 0; i < sim->n_core; i++){ // 1 core? does nothing
-                if (i != core) {
-                    access_cache(sim->cache[i], address,
-                            (action == LOAD) ? LD_MISS : ST_MISS);
-                }  
-            }
-        }
+        profile_next(prof);
+        simulate_access(sim, &acc);
     }
 
-    fclose(trace);
-    if (line) free(line);
+    if (reader) free_trace_reader(reader);
 
     printf("Processed %ld lines.\n", total_insn);
 
-    // compute cache statistics
-    for (i = 0; i < sim->n_core; i++){
-        calculate_stat_rates(sim->cache[i]->stats, sim->cache[i]->block_size);  
-        printf("    *** Results for Core %d ***\n", i);
-        print_stats(sim->cache[i]->stats, i);
-    }
+    print_results(sim);
 }
@@ -2,9 +2,25 @@
 #define __SIMULATOR_H
 
 #include <stdbool.h>
+#include <stdio.h>
 #include "cache.h"
 #include "cache_stats.h"
 
+// one decoded line of the trace: which core does what to which address
+typedef struct {
+  int core;
+  enum action_t action;
+  unsigned long address;
+  int size;        // in Bytes, 0 if the trace does not say
+} access_t;
+
+struct composer_s;
+struct sharing_s;
+struct vmem_s;
+struct profile_s;
+struct tuner_s;
+struct shared_cache_s;
+
 typedef struct {
   char* trace;
 
@@ -21,11 +37,53 @@ typedef struct {
   int n_core;
   cache_t** cache;
 
+  // all cores share one cache, sim->cache[i] are per core views of it.
+  // NULL for private caches
+  struct shared_cache_s *shared;
+
   enum protocol_t protocol;
+
+  // interleaves several single thread traces instead of reading sim->trace
+  struct composer_s *composer;
+
+  // tracks true vs false sharing per block, NULL if not analyzing
+  struct sharing_s *sharing;
+
+  int sharing_top_n;    // > 0 turns the sharing analysis on
+
+  // optional virtual to physical translation in front of the caches
+  struct vmem_s *vm;
+  int vm_page_bit;      // log2 of the page size, 0 if translation is off
+  int vm_policy;        // an enum palloc_t
+  int vm_pmem_bit;      // log2 of the physical memory size
+  int tlb_entries;
+  int tlb_assoc;
+
+  int format;           // an enum format_t, how sim->trace is encoded
+  bool ifetch_f;        // simulate instruction fetches of formats that have them
+
+  unsigned long seed;   // for the random schedule and random page placement
+
+  // times the pipeline stages, NULL unless -profile
+  struct profile_s *profile;
+
+  // searches cache geometries instead of simulating one, NULL unless -tune
+  struct tuner_s *tuner;
+
+  // streaming (daemon) mode, see stream.h
+  char* stream_path;   // FIFO to read accesses from, NULL if not streaming
+  char* socket_path;   // Unix socket to accept producers on, NULL if unused
+  char* metrics_path;  // where windowed stats go, NULL for stdout
+  long window;         // accesses per stats window
+  int interval;        // also publish every <interval> seconds, 0 for never
   
 } simulator_t;
 
 simulator_t* make_simulator();
+FILE *open_trace(char *name);
+bool parse_trace_line(simulator_t *sim, char *line, access_t *acc);
+bool simulate_access(simulator_t *sim, access_t *acc);
+void print_results(simulator_t *sim);
 void process_trace(simulator_t *sim);
 
 #endif  // SIMULATOR
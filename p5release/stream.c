@@ -0,0 +1,334 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "stream.h"
+#include "print_helpers.h"
+#include "profile.h"
+
+typedef struct {
+  int fd;
+  size_t len;            // bytes of a partial line left in buf
+  char buf[STREAM_BATCH];
+} producer_t;
+
+typedef struct {
+  FILE *out;
+  cache_stats_t *base;   // per core stats at the start of the window
+  long window_id;
+  long window_accesses;
+  long total_accesses;
+  long dropped;          // malformed lines or unknown cores
+  struct timespec last_publish;  // -interval counts from here
+} window_t;
+
+static volatile sig_atomic_t stop_f = 0;
+static volatile sig_atomic_t reset_f = 0;
+static volatile sig_atomic_t report_f = 0;
+
+static void on_signal(int sig) {
+  if (sig == SIGUSR1) reset_f = 1;
+  else if (sig == SIGUSR2) report_f = 1;
+  else stop_f = 1;
+}
+
+static void install_handlers() {
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = on_signal;  // no SA_RESTART, poll() has to wake up
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+  sigaction(SIGUSR1, &sa, NULL);
+  sigaction(SIGUSR2, &sa, NULL);
+  signal(SIGPIPE, SIG_IGN);
+}
+
+/* Prints the stats accumulated since the last window and starts a new one. */
+static void publish_window(simulator_t *sim, window_t *w) {
+  uint64_t t = profile_start_exact(sim->profile);
+  for (int i = 0; i < sim->n_core; i++) {
+    cache_stats_t *cur = sim->cache[i]->stats;
+    cache_stats_t *base = &w->base[i];
+    long accesses = cur->n_cpu_accesses - base->n_cpu_accesses;
+    long hits = cur->n_hits - base->n_hits;
+    long snoops = cur->n_bus_snoops - base->n_bus_snoops;
+    long snoop_hits = cur->n_snoop_hits - base->n_snoop_hits;
+    long writebacks = cur->n_writebacks - base->n_writebacks;
+
+    fprintf(w->out, "window %ld core %d accesses %ld hit_rate %.2f "
+            "snoops %ld snoop_hit_rate %.2f writebacks %ld wb_rate %.2f\n",
+            w->window_id, i, accesses,
+            accesses ? 100.0 * hits / accesses : 0.0,
+            snoops, snoops ? 100.0 * snoop_hits / snoops : 0.0,
+            writebacks, accesses ? 100.0 * writebacks / accesses : 0.0);
+    *base = *cur;
+  }
+  fflush(w->out);
+  w->window_id++;
+  w->window_accesses = 0;
+  clock_gettime(CLOCK_MONOTONIC, &w->last_publish);
+  profile_stop_exact(sim->profile, PROF_STATS, t);
+}
+
+/* Zeroes every core's stats without touching the cache contents. */
+static void reset_window(simulator_t *sim, window_t *w) {
+  for (int i = 0; i < sim->n_core; i++) {
+    reset_cache_stats(sim->cache[i]->stats);
+    w->base[i] = *sim->cache[i]->stats;
+  }
+  w->window_accesses = 0;
+  fprintf(w->out, "reset after %ld accesses\n", w->total_accesses);
+  fflush(w->out);
+}
+
+/* Milliseconds until the next -interval publish is due, -1 if never. */
+static int ms_to_deadline(simulator_t *sim, window_t *w) {
+  struct timespec now;
+
+  if (sim->interval <= 0) return -1;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  long elapsed = (now.tv_sec - w->last_publish.tv_sec) * 1000 +
+                 (now.tv_nsec - w->last_publish.tv_nsec) / 1000000;
+  long left = sim->interval * 1000L - elapsed;
+  return left > 0 ? left : 0;
+}
+
+/* Publishes if the interval has run out, whether or not the producers
+ * ever go quiet. An empty window is skipped but still restarts the clock.
+ */
+static void publish_if_due(simulator_t *sim, window_t *w) {
+  if (ms_to_deadline(sim, w) != 0) return;
+  if (w->window_accesses > 0)
+    publish_window(sim, w);
+  else
+    clock_gettime(CLOCK_MONOTONIC, &w->last_publish);
+}
+
+static void handle_line(simulator_t *sim, window_t *w, char *line) {
+  access_t acc;
+  uint64_t t;
+
+  if (line[0] == '#') {
+    if (strncmp(line, "#reset", 6) == 0) reset_window(sim, w);
+    else if (strncmp(line, "#report", 7) == 0) publish_window(sim, w);
+    return;
+  }
+  // sampled on the previous line's decision, a dropped line is not counted
+  t = profile_start(sim->profile);
+  bool ok_f = parse_trace_line(sim, line, &acc);
+  profile_stop(sim->profile, PROF_PARSE, t);
+  if (!ok_f || acc.core > sim->n_core - 1) {
+    w->dropped++;
+    return;
+  }
+
+  profile_next(sim->profile);
+  simulate_access(sim, &acc);
+  w->total_accesses++;
+  if (++w->window_accesses == sim->window) publish_window(sim, w);
+
+  if (sim->limit_insn_f && w->total_accesses == sim->insn_limit) {
+    printf("Reached insn limit of %d. Ending Simulation...\n", sim->insn_limit);
+    stop_f = 1;
+  }
+}
+
+/* Reads at most one batch from p and simulates every complete line in it.
+ * Returns false once the producer has gone away.
+ */
+static bool drain_producer(simulator_t *sim, window_t *w, producer_t *p) {
+  uint64_t t = profile_start_exact(sim->profile);
+  ssize_t n = read(p->fd, p->buf + p->len, STREAM_BATCH - 1 - p->len);
+  profile_stop_exact(sim->profile, PROF_IO, t);
+  if (n == 0) return false;
+  if (n < 0) return errno == EAGAIN || errno == EINTR;
+
+  size_t end = p->len + n;
+  size_t start = 0;
+  long n_line = 0;
+  for (size_t i = p->len; i < end && !stop_f; i++) {
+    if (p->buf[i] != '\n') continue;
+    p->buf[i] = '\0';
+    handle_line(sim, w, &p->buf[start]);
+    start = i + 1;
+    // a whole batch can take a while, do not let the deadline slip past it
+    if ((++n_line & (STREAM_CLOCK_CHECK - 1)) == 0) publish_if_due(sim, w);
+  }
+
+  if (start == 0 && end == STREAM_BATCH - 1) {
+    // no newline in a whole batch, this is not a trace
+    w->dropped++;
+    end = 0;
+  }
+  p->len = end - start;
+  memmove(p->buf, p->buf + start, p->len);
+  return true;
+}
+
+// we made the FIFO, so it is ours to remove on the way out
+static bool fifo_created_f = false;
+
+static int open_fifo(char *path) {
+  struct stat st;
+  if (stat(path, &st) != 0) {
+    if (mkfifo(path, 0666) != 0) {
+      printf("Could not create FIFO \'%s\'\n", path);
+      exit(EXIT_FAILURE);
+    }
+    fifo_created_f = true;
+  } else if (!S_ISFIFO(st.st_mode)) {
+    printf("\'%s\' is not a FIFO\n", path);
+    exit(EXIT_FAILURE);
+  }
+  // non blocking so we do not hang in open() waiting for the first writer
+  int fd = open(path, O_RDONLY | O_NONBLOCK);
+  if (fd < 0) {
+    printf("Could not open FIFO \'%s\'\n", path);
+    exit(EXIT_FAILURE);
+  }
+  return fd;
+}
+
+static int open_socket(char *path) {
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    printf("Socket path \'%s\' too long\n", path);
+    exit(EXIT_FAILURE);
+  }
+  strcpy(addr.sun_path, path);
+  unlink(path);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+      listen(fd, STREAM_MAX_PRODUCERS) != 0) {
+    printf("Could not listen on socket \'%s\'\n", path);
+    exit(EXIT_FAILURE);
+  }
+  return fd;
+}
+
+void process_stream(simulator_t *sim) {
+  producer_t *producers[STREAM_MAX_PRODUCERS];
+  struct pollfd fds[STREAM_MAX_PRODUCERS + 1];
+  int n_producer = 0;
+  int listen_fd = -1;
+  window_t w;
+
+  printf("Processing stream...\n");
+  printf("%d %d\n", sim->n_core, sim->protocol);
+
+  w.out = stdout;
+  if (sim->metrics_path) {
+    w.out = fopen(sim->metrics_path, "a");
+    if (w.out == NULL) {
+      printf("Could not open metrics file \'%s\'\n", sim->metrics_path);
+      exit(EXIT_FAILURE);
+    }
+  }
+  w.base = calloc(sim->n_core, sizeof(cache_stats_t));
+  w.window_id = 0;
+  w.window_accesses = 0;
+  w.total_accesses = 0;
+  w.dropped = 0;
+  clock_gettime(CLOCK_MONOTONIC, &w.last_publish);
+
+  install_handlers();
+
+  if (sim->socket_path) {
+    listen_fd = open_socket(sim->socket_path);
+  } else {
+    producers[n_producer] = malloc(sizeof(producer_t));
+    producers[n_producer]->fd = open_fifo(sim->stream_path);
+    producers[n_producer]->len = 0;
+    n_producer++;
+  }
+
+  while (!stop_f) {
+    int nfds = 0;
+    for (int i = 0; i < n_producer; i++) {
+      fds[nfds].fd = producers[i]->fd;
+      fds[nfds++].events = POLLIN;
+    }
+    if (listen_fd >= 0) {
+      fds[nfds].fd = listen_fd;
+      fds[nfds++].events = POLLIN;
+    }
+
+    int ready = poll(fds, nfds, ms_to_deadline(sim, &w));
+
+    if (reset_f) {
+      reset_f = 0;
+      reset_window(sim, &w);
+    }
+    if (report_f) {
+      report_f = 0;
+      publish_window(sim, &w);
+    }
+    publish_if_due(sim, &w);
+    if (ready <= 0) continue;
+
+    // one batch per ready producer per round keeps them from starving each other
+    for (int i = 0; i < n_producer && !stop_f; i++) {
+      if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+      if (drain_producer(sim, &w, producers[i])) continue;
+
+      // gone in the middle of a line, that line is lost
+      if (producers[i]->len > 0) w.dropped++;
+      close(producers[i]->fd);
+      producers[i]->len = 0;
+      if (listen_fd < 0) {
+        // last writer closed the FIFO, wait for the next one
+        producers[i]->fd = open_fifo(sim->stream_path);
+      } else {
+        free(producers[i]);
+        producers[i] = producers[--n_producer];
+        fds[i] = fds[n_producer];
+        i--;
+      }
+    }
+
+    if (listen_fd >= 0 && (fds[nfds - 1].revents & POLLIN)) {
+      int fd = accept(listen_fd, NULL, NULL);
+      if (fd >= 0 && n_producer == STREAM_MAX_PRODUCERS) {
+        close(fd);  // full, the producer can retry later
+      } else if (fd >= 0) {
+        producers[n_producer] = malloc(sizeof(producer_t));
+        producers[n_producer]->fd = fd;
+        producers[n_producer]->len = 0;
+        n_producer++;
+      }
+    }
+  }
+
+  if (w.window_accesses > 0) publish_window(sim, &w);
+
+  for (int i = 0; i < n_producer; i++) {
+    if (producers[i]->len > 0) w.dropped++;
+    close(producers[i]->fd);
+    free(producers[i]);
+  }
+  if (listen_fd >= 0) {
+    close(listen_fd);
+    unlink(sim->socket_path);
+  }
+  if (fifo_created_f) unlink(sim->stream_path);
+  if (w.out != stdout) fclose(w.out);
+  free(w.base);
+
+  printf("Processed %ld lines (%ld dropped).\n", w.total_accesses, w.dropped);
+
+  print_results(sim);
+}
@@ -0,0 +1,25 @@
+#ifndef __STREAM_H
+#define __STREAM_H
+
+#include "simulator.h"
+
+// bytes read from a producer in one go. we never read more than this
+// ahead of the simulation, so a fast producer blocks on a full pipe
+// (or socket buffer) instead of us buffering its whole trace.
+#define STREAM_BATCH 65536
+#define STREAM_MAX_PRODUCERS 16
+// lines between -interval deadline checks within a batch (a power of 2)
+#define STREAM_CLOCK_CHECK 256
+
+/* Long running mode: consumes "<core> <r|w> <hexaddr>" lines from a FIFO
+ * or from producers connecting to a Unix socket, and publishes windowed
+ * per core stats every sim->window accesses.
+ *
+ * Lines starting with '#' are commands: "#reset" zeroes the stats,
+ * "#report" publishes the current window right away.
+ * Signals: SIGUSR1 = reset, SIGUSR2 = report, SIGINT/SIGTERM = print
+ * the totals and exit.
+ */
+void process_stream(simulator_t *sim);
+
+#endif  // STREAM
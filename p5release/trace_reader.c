@@ -0,0 +1,244 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "trace_reader.h"
+#include "profile.h"
+
+// drcachesim trace_type_t values we care about, the rest is skipped
+#define DR_READ 0
+#define DR_WRITE 1
+#define DR_INSTR_FIRST 10        // TRACE_TYPE_INSTR
+#define DR_INSTR_LAST 16         // TRACE_TYPE_INSTR_RETURN
+#define DR_THREAD 22
+
+trace_reader_t *make_trace_reader(FILE *file, enum format_t format, int block_size,
+                                  bool ifetch_f, struct profile_s *profile) {
+  trace_reader_t *reader = malloc(sizeof(trace_reader_t));
+
+  reader->file = file;
+  reader->format = format;
+  reader->block_size = block_size;
+  reader->offset = 0;
+  reader->ifetch_f = ifetch_f;
+  reader->profile = profile;
+
+  reader->buf = malloc(READER_BUFFER + 1);  // + 1 for a final '\0'
+  reader->pos = 0;
+  reader->len = 0;
+  reader->eof_f = false;
+
+  reader->q_head = 0;
+  reader->q_len = 0;
+  reader->cur_f = false;
+
+  reader->n_tid = 0;
+  reader->core = 0;
+
+  return reader;
+}
+
+void free_trace_reader(trace_reader_t *reader) {
+  if (reader->file != stdin) fclose(reader->file);
+  free(reader->buf);
+  free(reader);
+}
+
+/* Moves the unread bytes to the front and reads as many more as fit. */
+static void refill(trace_reader_t *reader) {
+  uint64_t t = profile_start_exact(reader->profile);
+
+  memmove(reader->buf, reader->buf + reader->pos, reader->len - reader->pos);
+  reader->len -= reader->pos;
+  reader->pos = 0;
+  size_t n = fread(reader->buf + reader->len, 1, READER_BUFFER - reader->len, reader->file);
+  if (n == 0) reader->eof_f = true;
+  reader->len += n;
+
+  profile_stop_exact(reader->profile, PROF_IO, t);
+}
+
+/* makes sure n bytes can be read at buf + pos, false if the trace ends first */
+static bool need(trace_reader_t *reader, size_t n) {
+  while (reader->len - reader->pos < n && !reader->eof_f) refill(reader);
+  return reader->len - reader->pos >= n;
+}
+
+/* Returns the next line without its '\n', NULL at the end of the trace. */
+static char *next_line(trace_reader_t *reader) {
+  for (;;) {
+    char *start = reader->buf + reader->pos;
+    char *nl = memchr(start, '\n', reader->len - reader->pos);
+    if (nl) {
+      *nl = '\0';
+      reader->pos = nl - reader->buf + 1;
+      return start;
+    }
+    if (reader->eof_f) {
+      if (reader->pos == reader->len) return NULL;
+      reader->buf[reader->len] = '\0';  // last line has no '\n'
+      reader->pos = reader->len;
+      return start;
+    }
+    if (reader->pos == 0 && reader->len == READER_BUFFER) {
+      reader->len = 0;  // a line that does not fit is no access anyway
+    }
+    refill(reader);
+  }
+}
+
+static void push(trace_reader_t *reader, enum action_t action, unsigned long addr, int size) {
+  access_t *acc = &reader->queue[(reader->q_head + reader->q_len) % READER_QUEUE];
+  acc->core = reader->core;
+  acc->action = action;
+  acc->address = addr;
+  acc->size = size;
+  reader->q_len++;
+}
+
+/* "I  0401c10,3" / " L 1ffefffe68,8" / " S ..." / " M ..." */
+static void decode_lackey(trace_reader_t *reader, char *line) {
+  char *p = line;
+
+  while (*p == ' ') p++;
+  char kind = *p++;
+  if (*p != ' ') return;  // valgrind's own "==pid==" chatter
+  unsigned long addr = strtoul(p, &p, 16);
+  int size = (*p == ',') ? atoi(p + 1) : 0;
+
+  switch (kind) {
+  case 'I':
+    if (reader->ifetch_f) push(reader, LOAD, addr, size);
+    break;
+  case 'L':
+    push(reader, LOAD, addr, size);
+    break;
+  case 'S':
+    push(reader, STORE, addr, size);
+    break;
+  case 'M':
+    // read-modify-write
+    push(reader, LOAD, addr, size);
+    push(reader, STORE, addr, size);
+    break;
+  }
+}
+
+static void decode_drcachesim(trace_reader_t *reader, drcachesim_entry_t *entry) {
+  if (entry->type == DR_READ) {
+    push(reader, LOAD, entry->addr, entry->size);
+  } else if (entry->type == DR_WRITE) {
+    push(reader, STORE, entry->addr, entry->size);
+  } else if (entry->type >= DR_INSTR_FIRST && entry->type <= DR_INSTR_LAST) {
+    if (reader->ifetch_f) push(reader, LOAD, entry->addr, entry->size);
+  } else if (entry->type == DR_THREAD) {
+    for (reader->core = 0; reader->core < reader->n_tid; reader->core++) {
+      if (reader->tids[reader->core] == entry->addr) return;
+    }
+    if (reader->n_tid == READER_MAX_THREADS) {
+      printf("ERROR: trace has more than %d threads!\n", READER_MAX_THREADS);
+      exit(EXIT_FAILURE);
+    }
+    reader->tids[reader->n_tid++] = entry->addr;
+  }
+}
+
+static void decode_champsim(trace_reader_t *reader, champsim_instr_t *instr) {
+  // ChampSim records addresses, not sizes: every access stays in one block
+  if (reader->ifetch_f) push(reader, LOAD, instr->ip, 0);
+  for (int i = 0; i < 4; i++) {
+    if (instr->source_memory[i]) push(reader, LOAD, instr->source_memory[i], 0);
+  }
+  for (int i = 0; i < 2; i++) {
+    if (instr->destination_memory[i]) push(reader, STORE, instr->destination_memory[i], 0);
+  }
+}
+
+/* Decodes one record into the queue, false at the end of the trace. */
+static bool decode_record(trace_reader_t *reader) {
+  char *line;
+  access_t acc;
+  drcachesim_entry_t entry;
+  champsim_instr_t instr;
+
+  switch (reader->format) {
+  case FORMAT_NATIVE:
+    if ((line = next_line(reader)) == NULL) return false;
+    if (parse_trace_line(NULL, line, &acc)) {
+      reader->core = acc.core;
+      push(reader, acc.action, acc.address, acc.size);
+    }
+    return true;
+
+  case FORMAT_LACKEY:
+    if ((line = next_line(reader)) == NULL) return false;
+    decode_lackey(reader, line);
+    return true;
+
+  case FORMAT_DRCACHESIM:
+    if (!need(reader, sizeof(entry))) return false;
+    memcpy(&entry, reader->buf + reader->pos, sizeof(entry));
+    reader->pos += sizeof(entry);
+    decode_drcachesim(reader, &entry);
+    return true;
+
+  case FORMAT_CHAMPSIM:
+    if (!need(reader, sizeof(instr))) return false;
+    memcpy(&instr, reader->buf + reader->pos, sizeof(instr));
+    reader->pos += sizeof(instr);
+    decode_champsim(reader, &instr);
+    return true;
+  }
+  return false;
+}
+
+bool trace_reader_next(trace_reader_t *reader, access_t *acc) {
+  while (!reader->cur_f) {
+    if (reader->q_len > 0) {
+      reader->cur = reader->queue[reader->q_head];
+      reader->q_head = (reader->q_head + 1) % READER_QUEUE;
+      reader->q_len--;
+      reader->cur.address += reader->offset;
+      reader->cur_f = true;
+    } else if (!decode_record(reader)) {
+      return false;
+    }
+  }
+
+  *acc = reader->cur;
+  if (reader->cur.size > 0) {
+    // split at the block boundary, the rest comes out next time
+    int room = reader->block_size - (reader->cur.address & (reader->block_size - 1));
+    if (reader->cur.size > room) {
+      acc->size = room;
+      reader->cur.address += room;
+      reader->cur.size -= room;
+      return true;
+    }
+  }
+  reader->cur_f = false;
+  return true;
+}
+
+int parse_format(char *name) {
+  if (strcmp(name, "native") == 0) return FORMAT_NATIVE;
+  if (strcmp(name, "lackey") == 0) return FORMAT_LACKEY;
+  if (strcmp(name, "drcachesim") == 0) return FORMAT_DRCACHESIM;
+  if (strcmp(name, "champsim") == 0) return FORMAT_CHAMPSIM;
+  return -1;
+}
+
+char *format_to_str(enum format_t format) {
+  switch (format) {
+  case FORMAT_NATIVE:
+    return "native";
+  case FORMAT_LACKEY:
+    return "lackey";
+  case FORMAT_DRCACHESIM:
+    return "drcachesim";
+  case FORMAT_CHAMPSIM:
+    return "champsim";
+  }
+  return "-";
+}
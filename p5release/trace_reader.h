@@ -0,0 +1,76 @@
+#ifndef __TRACE_READER_H
+#define __TRACE_READER_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "simulator.h"
+
+// bytes pulled from the trace file per read()
+#define READER_BUFFER (1 << 20)
+// most accesses one record can hold (ChampSim: 1 fetch, 2 stores, 4 loads)
+#define READER_QUEUE 8
+#define READER_MAX_THREADS 1024
+
+enum format_t {
+  FORMAT_NATIVE,      // "<core> <r|w> <hexaddr>", what trace/ holds
+  FORMAT_LACKEY,      // valgrind --tool=lackey --trace-mem=yes
+  FORMAT_DRCACHESIM,  // DynamoRIO drcachesim raw trace_entry_t records
+  FORMAT_CHAMPSIM     // ChampSim input_instr records
+};
+
+// the record layouts of the two binary formats
+typedef struct __attribute__((packed)) {
+  unsigned short type;
+  unsigned short size;
+  unsigned long addr;
+} drcachesim_entry_t;
+
+typedef struct __attribute__((packed)) {
+  unsigned long ip;
+  unsigned char is_branch;
+  unsigned char branch_taken;
+  unsigned char destination_registers[2];
+  unsigned char source_registers[4];
+  unsigned long destination_memory[2];
+  unsigned long source_memory[4];
+} champsim_instr_t;
+
+typedef struct trace_reader_s {
+  FILE *file;
+  enum format_t format;
+  int block_size;     // accesses are split so none crosses a block
+  unsigned long offset;  // added to every address before it is split
+  bool ifetch_f;      // also simulate instruction fetches, as loads
+  struct profile_s *profile;
+
+  char *buf;
+  size_t pos;
+  size_t len;
+  bool eof_f;
+
+  // decoded accesses of the current record, split lazily
+  access_t queue[READER_QUEUE];
+  int q_head;
+  int q_len;
+  access_t cur;       // access being split, cur.size bytes still to go
+  bool cur_f;
+
+  // drcachesim interleaves threads, each new thread id gets the next core
+  long tids[READER_MAX_THREADS];
+  int n_tid;
+  int core;           // core of the single thread formats / current thread
+} trace_reader_t;
+
+trace_reader_t *make_trace_reader(FILE *file, enum format_t format, int block_size,
+                                  bool ifetch_f, struct profile_s *profile);
+void free_trace_reader(trace_reader_t *reader);
+
+/* Fills in the next access of the trace, none of which spans two blocks.
+ * Returns false at the end of the trace.
+ */
+bool trace_reader_next(trace_reader_t *reader, access_t *acc);
+
+int parse_format(char *name);
+char *format_to_str(enum format_t format);
+
+#endif  // TRACE_READER
@@ -0,0 +1,257 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "tune.h"
+#include "cache.h"
+#include "trace_reader.h"
+#include "lru_stack.h"
+
+tuner_t *make_tuner(double target) {
+  tuner_t *tuner = malloc(sizeof(tuner_t));
+
+  tuner->target = target;
+  // the grid graph1.py sweeps by brute force
+  tuner->log_cap_lo = 10;
+  tuner->log_cap_hi = 21;
+  tuner->log_bsize_lo = 6;
+  tuner->log_bsize_hi = 6;
+  tuner->max_assoc = 4;
+  tuner->prefix = 0;
+
+  tuner->addr = NULL;
+  tuner->action = NULL;
+  tuner->n_access = 0;
+
+  tuner->n_screen_pass = 0;
+  tuner->n_full_sim = 0;
+  tuner->n_result = 0;
+
+  return tuner;
+}
+
+static int log2_int(int n) {
+  int log = 0;
+  while ((1 << log) < n) log++;
+  return log;
+}
+
+/* Loads core 0's accesses, the stream a private cache of that core sees. */
+static void load_trace(simulator_t *sim, tuner_t *tuner) {
+  trace_reader_t *reader = make_trace_reader(open_trace(sim->trace), sim->format,
+                                             1 << tuner->log_bsize_lo, sim->ifetch_f, NULL);
+  long size = 1 << 16;
+  long n_line = 0;
+  access_t acc;
+
+  tuner->addr = malloc(size * sizeof(unsigned long));
+  tuner->action = malloc(size * sizeof(enum action_t));
+
+  while (trace_reader_next(reader, &acc)) {
+    if (sim->limit_insn_f && n_line++ == sim->insn_limit) break;
+    if (acc.core != 0) continue;
+    if (tuner->n_access == size) {
+      size *= 2;
+      tuner->addr = realloc(tuner->addr, size * sizeof(unsigned long));
+      tuner->action = realloc(tuner->action, size * sizeof(enum action_t));
+    }
+    tuner->addr[tuner->n_access] = acc.address;
+    tuner->action[tuner->n_access] = acc.action;
+    tuner->n_access++;
+  }
+  free_trace_reader(reader);
+
+  if (tuner->prefix <= 0 || tuner->prefix > tuner->n_access)
+    tuner->prefix = tuner->prefix > 0 ? tuner->n_access : tuner->n_access / 10;
+  if (tuner->prefix == 0) tuner->prefix = tuner->n_access;
+}
+
+/* One pass over the prefix with true LRU stacks of depth max_assoc gives
+ * the misses of every assoc a <= max_assoc at once (LRU inclusion: what an
+ * a-way set holds is the top a entries of the stack).
+ * misses[la] gets the miss rate, in percent, of assoc 1 << la.
+ */
+static void screen(tuner_t *tuner, int log_bsize, int log_set, double *misses) {
+  int depth = tuner->max_assoc;
+  long n_set = 1L << log_set;
+  unsigned long *stacks = calloc(n_set * depth, sizeof(unsigned long));
+  long *depth_hits = calloc(depth, sizeof(long));
+
+  for (long i = 0; i < tuner->prefix; i++) {
+    unsigned long key = (tuner->addr[i] >> log_bsize) + 1;  // 0 marks empty
+    unsigned long *stack = &stacks[((key - 1) & (n_set - 1)) * depth];
+
+    int d = lru_stack_touch(stack, depth, key);
+    if (d >= 0) depth_hits[d]++;
+  }
+
+  long hits = 0;
+  for (int la = 0, d = 0; (1 << la) <= depth; la++) {
+    for (; d < (1 << la); d++) hits += depth_hits[d];
+    misses[la] = 100.0 * (tuner->prefix - hits) / tuner->prefix;
+  }
+
+  free(stacks);
+  free(depth_hits);
+  tuner->n_screen_pass++;
+}
+
+/* Miss rate, in percent, of the real cache over the whole trace. */
+static double full_sim(tuner_t *tuner, int log_cap, int log_bsize, int assoc) {
+  cache_t *cache = make_cache(1 << log_cap, 1 << log_bsize, assoc, NONE, false);
+  long hits = 0;
+
+  for (long i = 0; i < tuner->n_access; i++) {
+    hits += access_cache(cache, tuner->addr[i], tuner->action[i]);
+  }
+  free_cache(cache);
+  tuner->n_full_sim++;
+
+  return 100.0 * (tuner->n_access - hits) / tuner->n_access;
+}
+
+static void add_result(tuner_t *tuner, int log_cap, int log_bsize, int assoc, double miss_rate) {
+  if (tuner->n_result == MAX_TUNE_RESULTS) return;
+  tune_result_t *result = &tuner->results[tuner->n_result++];
+  result->log_cap = log_cap;
+  result->log_bsize = log_bsize;
+  result->assoc = assoc;
+  result->miss_rate = miss_rate;
+}
+
+/* Confirms a screened candidate on the full trace. The prefix has more cold
+ * misses than the whole trace, so first walk down while smaller caches still
+ * make it, otherwise walk up until one does. Both walks stop at the first
+ * capacity that flips, the curve being monotone.
+ */
+static void confirm(tuner_t *tuner, int log_cap, int log_bsize, int assoc) {
+  int log_min = log_bsize + log2_int(assoc);
+  if (log_min < tuner->log_cap_lo) log_min = tuner->log_cap_lo;
+  double rate = full_sim(tuner, log_cap, log_bsize, assoc);
+
+  if (rate < tuner->target) {
+    while (log_cap > log_min) {
+      double smaller = full_sim(tuner, log_cap - 1, log_bsize, assoc);
+      if (smaller >= tuner->target) break;
+      log_cap--;
+      rate = smaller;
+    }
+    add_result(tuner, log_cap, log_bsize, assoc, rate);
+    return;
+  }
+
+  while (++log_cap <= tuner->log_cap_hi) {
+    rate = full_sim(tuner, log_cap, log_bsize, assoc);
+    if (rate < tuner->target) {
+      add_result(tuner, log_cap, log_bsize, assoc, rate);
+      return;
+    }
+  }
+}
+
+static void tune_block_size(tuner_t *tuner, int log_bsize) {
+  int log_max_assoc = log2_int(tuner->max_assoc);
+  int best[32];
+  double misses[32];
+
+  for (int la = 0; la <= log_max_assoc; la++) best[la] = -1;
+
+  int log_set = tuner->log_cap_lo - log_bsize - log_max_assoc;
+  if (log_set < 0) log_set = 0;
+
+  for (; log_set + log_bsize <= tuner->log_cap_hi; log_set++) {
+    // is any assoc still looking for its capacity in range?
+    bool open_f = false;
+    for (int la = 0; la <= log_max_assoc; la++) {
+      int log_cap = log_set + log_bsize + la;
+      if (best[la] < 0 && log_cap >= tuner->log_cap_lo && log_cap <= tuner->log_cap_hi)
+        open_f = true;
+    }
+    if (!open_f) {
+      // every curve already crossed the target, bigger caches can only do better
+      bool done_f = true;
+      for (int la = 0; la <= log_max_assoc; la++) {
+        if (best[la] < 0 && log_set + log_bsize + la < tuner->log_cap_lo) done_f = false;
+      }
+      if (done_f) break;
+      continue;
+    }
+
+    screen(tuner, log_bsize, log_set, misses);
+    for (int la = 0; la <= log_max_assoc; la++) {
+      int log_cap = log_set + log_bsize + la;
+      if (best[la] < 0 && log_cap >= tuner->log_cap_lo && log_cap <= tuner->log_cap_hi &&
+          misses[la] < tuner->target)
+        best[la] = log_cap;
+    }
+  }
+
+  for (int la = 0; la <= log_max_assoc; la++) {
+    if (best[la] >= 0) {
+      confirm(tuner, best[la], log_bsize, 1 << la);
+    } else if (tuner->log_cap_hi >= log_bsize + la) {
+      // the prefix never made it, the full trace still might at the top
+      confirm(tuner, tuner->log_cap_hi, log_bsize, 1 << la);
+    }
+  }
+}
+
+/* true if b is at least as cheap as a in capacity, assoc and miss rate and
+ * strictly better in one of them */
+static bool dominates(tune_result_t *b, tune_result_t *a) {
+  if (b->log_cap > a->log_cap || b->assoc > a->assoc || b->miss_rate > a->miss_rate)
+    return false;
+  return b->log_cap < a->log_cap || b->assoc < a->assoc || b->miss_rate < a->miss_rate;
+}
+
+static int compare_results(const void *x, const void *y) {
+  const tune_result_t *a = x;
+  const tune_result_t *b = y;
+  if (a->log_cap != b->log_cap) return a->log_cap - b->log_cap;
+  if (a->assoc != b->assoc) return a->assoc - b->assoc;
+  return a->log_bsize - b->log_bsize;
+}
+
+void run_tuner(simulator_t *sim, tuner_t *tuner) {
+  long n_grid = 0;
+
+  printf("Tuning...\n");
+  load_trace(sim, tuner);
+  if (tuner->n_access == 0) {
+    printf("ERROR: trace has no accesses for core 0!\n");
+    exit(EXIT_FAILURE);
+  }
+
+  for (int lb = tuner->log_bsize_lo; lb <= tuner->log_bsize_hi; lb++) {
+    for (int a = 1; a <= tuner->max_assoc; a *= 2) {
+      for (int lc = tuner->log_cap_lo; lc <= tuner->log_cap_hi; lc++) {
+        if (lc >= lb + log2_int(a)) n_grid++;
+      }
+    }
+    tune_block_size(tuner, lb);
+  }
+
+  qsort(tuner->results, tuner->n_result, sizeof(tune_result_t), compare_results);
+
+  printf("    *** Auto-Tuner ***\n");
+  printf("tune.target_miss_rate \t%.2f\n", tuner->target);
+  printf("tune.n_accesses \t%ld\n", tuner->n_access);
+  printf("tune.n_prefix \t\t%ld\n", tuner->prefix);
+  printf("tune.n_grid_configs \t%ld\n", n_grid);
+  printf("tune.n_screen_passes \t%ld\n", tuner->n_screen_pass);
+  printf("tune.n_full_sims \t%ld\n", tuner->n_full_sim);
+  printf("Pareto-optimal configurations:\n");
+  for (int i = 0; i < tuner->n_result; i++) {
+    bool dominated_f = false;
+    for (int j = 0; j < tuner->n_result; j++) {
+      if (dominates(&tuner->results[j], &tuner->results[i])) dominated_f = true;
+    }
+    if (dominated_f) continue;
+    tune_result_t *r = &tuner->results[i];
+    printf("  -cache %d %d %d \tcapacity %d B, block %d B, %d-way, miss_rate %.2f\n",
+           r->log_cap, r->log_bsize, r->assoc, 1 << r->log_cap, 1 << r->log_bsize,
+           r->assoc, r->miss_rate);
+  }
+  if (tuner->n_result == 0)
+    printf("  none, no configuration in range gets below %.2f\n", tuner->target);
+}
@@ -0,0 +1,43 @@
+#ifndef __TUNE_H
+#define __TUNE_H
+
+#include <stdbool.h>
+#include "simulator.h"
+
+#define MAX_TUNE_RESULTS 256
+
+// one cache geometry and how it did
+typedef struct {
+  int log_cap;
+  int log_bsize;
+  int assoc;
+  double miss_rate;       // in percent, measured on the full trace
+} tune_result_t;
+
+typedef struct tuner_s {
+  double target;          // miss rate to beat, in percent
+  int log_cap_lo, log_cap_hi;
+  int log_bsize_lo, log_bsize_hi;
+  int max_assoc;          // assoc goes 1, 2, 4, ... max_assoc
+  long prefix;            // accesses screened, 0 for a tenth of the trace
+
+  // the trace of core 0, loaded once
+  unsigned long *addr;
+  enum action_t *action;
+  long n_access;
+
+  long n_screen_pass;     // prefix passes, each one covers every assoc
+  long n_full_sim;        // full trace simulations
+
+  tune_result_t results[MAX_TUNE_RESULTS];
+  int n_result;
+} tuner_t;
+
+tuner_t *make_tuner(double target);
+
+/* Finds the cheapest geometries within the tuner's ranges whose miss rate
+ * is below target, printing the Pareto-optimal ones as -cache settings.
+ */
+void run_tuner(simulator_t *sim, tuner_t *tuner);
+
+#endif  // TUNE
@@ -0,0 +1,196 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "vmem.h"
+#include "hash.h"
+
+#define VMEM_INITIAL_CAPACITY 1024
+
+vmem_t *make_vmem(int n_core, int n_page_bit, enum palloc_t policy, int n_pmem_bit,
+                  int tlb_entries, int tlb_assoc, long cache_way_bytes, unsigned long seed) {
+  vmem_t *vm = malloc(sizeof(vmem_t));
+
+  vm->n_page_bit = n_page_bit;
+  vm->policy = policy;
+
+  vm->capacity = VMEM_INITIAL_CAPACITY;
+  vm->vpn = calloc(vm->capacity, sizeof(unsigned long));
+  vm->pfn = calloc(vm->capacity, sizeof(unsigned long));
+  vm->n_page = 0;
+
+  vm->n_frame = 1L << (n_pmem_bit - n_page_bit);
+  vm->used = calloc(vm->n_frame / 8 + 1, 1);
+  vm->next_frame = 0;
+  // a page's color is the part of its frame number that lands in the
+  // cache index, so a cache way that spans k pages has k colors
+  vm->n_color = cache_way_bytes >> n_page_bit;
+  if (vm->n_color < 1) vm->n_color = 1;
+  if (vm->n_color > vm->n_frame) vm->n_color = vm->n_frame;
+  vm->next_in_color = malloc(vm->n_color * sizeof(long));
+  for (long c = 0; c < vm->n_color; c++) vm->next_in_color[c] = c;
+  vm->n_off_color = 0;
+  vm->rng = seed_random(seed);
+
+  vm->n_core = n_core;
+  vm->tlb_assoc = tlb_assoc;
+  vm->tlb_n_set = tlb_entries / tlb_assoc;
+  vm->tlb = malloc(n_core * sizeof(tlb_entry_t *));
+  for (int i = 0; i < n_core; i++) vm->tlb[i] = calloc(tlb_entries, sizeof(tlb_entry_t));
+  vm->stats = calloc(n_core, sizeof(tlb_stats_t));
+  vm->clock = 0;
+
+  return vm;
+}
+
+static bool frame_used(vmem_t *vm, long frame) {
+  return (vm->used[frame >> 3] >> (frame & 7)) & 1;
+}
+
+static long take_frame(vmem_t *vm, long frame) {
+  vm->used[frame >> 3] |= 1 << (frame & 7);
+  return frame;
+}
+
+static void out_of_memory(vmem_t *vm) {
+  printf("ERROR: out of physical memory after %ld pages!\n", vm->n_page);
+  exit(EXIT_FAILURE);
+}
+
+/* Next free frame of a color, -1 once the color has none left. */
+static long frame_in_color(vmem_t *vm, long color) {
+  long frame = vm->next_in_color[color];
+
+  while (frame < vm->n_frame && frame_used(vm, frame)) frame += vm->n_color;
+  if (frame >= vm->n_frame) return -1;
+  vm->next_in_color[color] = frame + vm->n_color;
+  return frame;
+}
+
+/* Picks a free physical frame for vpn according to the policy. */
+static long alloc_frame(vmem_t *vm, unsigned long vpn) {
+  long frame, color;
+
+  if (vm->n_page >= vm->n_frame) out_of_memory(vm);
+
+  switch (vm->policy) {
+  case PALLOC_SEQ:
+    while (frame_used(vm, vm->next_frame)) vm->next_frame++;
+    return take_frame(vm, vm->next_frame++);
+
+  case PALLOC_RANDOM:
+    frame = next_random(&vm->rng) % vm->n_frame;
+    while (frame_used(vm, frame)) frame = (frame + 1) % vm->n_frame;
+    return take_frame(vm, frame);
+
+  case PALLOC_COLOR:
+    // same color as the virtual page, so virtually contiguous data
+    // spreads over the cache sets the way the program laid it out
+    color = vpn % vm->n_color;
+    frame = frame_in_color(vm, color);
+    // the color is full, take the nearest one with a frame left. there is
+    // one, fewer pages are mapped than there are frames
+    if (frame < 0) vm->n_off_color++;
+    for (long d = 1; frame < 0; d++) {
+      frame = frame_in_color(vm, (color + d) % vm->n_color);
+      if (frame < 0) frame = frame_in_color(vm, (color + vm->n_color - d) % vm->n_color);
+    }
+    return take_frame(vm, frame);
+  }
+  return -1;
+}
+
+static void grow_page_table(vmem_t *vm) {
+  unsigned long *old_vpn = vm->vpn;
+  unsigned long *old_pfn = vm->pfn;
+  long old_capacity = vm->capacity;
+
+  vm->capacity *= 2;
+  vm->vpn = calloc(vm->capacity, sizeof(unsigned long));
+  vm->pfn = calloc(vm->capacity, sizeof(unsigned long));
+  for (long i = 0; i < old_capacity; i++) {
+    if (old_vpn[i] == 0) continue;
+    long slot = hash_slot(old_vpn[i], vm->capacity);
+    while (vm->vpn[slot] != 0) slot = (slot + 1) & (vm->capacity - 1);
+    vm->vpn[slot] = old_vpn[i];
+    vm->pfn[slot] = old_pfn[i];
+  }
+  free(old_vpn);
+  free(old_pfn);
+}
+
+/* Walks the page table, mapping the page if this is its first touch. */
+static unsigned long walk(vmem_t *vm, unsigned long vpn) {
+  unsigned long key = vpn + 1;
+  long slot = hash_slot(key, vm->capacity);
+
+  while (vm->vpn[slot] != 0) {
+    if (vm->vpn[slot] == key) return vm->pfn[slot];
+    slot = (slot + 1) & (vm->capacity - 1);
+  }
+
+  if (2 * (vm->n_page + 1) > vm->capacity) {
+    grow_page_table(vm);
+    return walk(vm, vpn);
+  }
+  vm->vpn[slot] = key;
+  vm->pfn[slot] = alloc_frame(vm, vpn);
+  vm->n_page++;
+  return vm->pfn[slot];
+}
+
+unsigned long translate(vmem_t *vm, int core, unsigned long vaddr) {
+  unsigned long vpn = vaddr >> vm->n_page_bit;
+  unsigned long offset = vaddr & ((1UL << vm->n_page_bit) - 1);
+  tlb_entry_t *set = &vm->tlb[core][(vpn % vm->tlb_n_set) * vm->tlb_assoc];
+  int victim = 0;
+
+  vm->stats[core].n_access++;
+  vm->clock++;
+
+  for (int i = 0; i < vm->tlb_assoc; i++) {
+    if (set[i].valid && set[i].vpn == vpn) {
+      vm->stats[core].n_hit++;
+      set[i].last_use = vm->clock;
+      return (set[i].pfn << vm->n_page_bit) | offset;
+    }
+    // invalid ways first, then the least recently used one
+    if (set[victim].valid && (!set[i].valid || set[i].last_use < set[victim].last_use))
+      victim = i;
+  }
+
+  set[victim].vpn = vpn;
+  set[victim].pfn = walk(vm, vpn);
+  set[victim].valid = true;
+  set[victim].last_use = vm->clock;
+  return (set[victim].pfn << vm->n_page_bit) | offset;
+}
+
+char *palloc_to_str(enum palloc_t policy) {
+  switch (policy) {
+  case PALLOC_SEQ:
+    return "seq";
+  case PALLOC_RANDOM:
+    return "random";
+  case PALLOC_COLOR:
+    return "color";
+  }
+  return "-";
+}
+
+void print_vmem(vmem_t *vm) {
+  printf("    *** Address Translation ***\n");
+  printf("vm.page_size \t\t%ld B\n", 1L << vm->n_page_bit);
+  printf("vm.policy \t\t%s\n", palloc_to_str(vm->policy));
+  printf("vm.n_color \t\t%ld\n", vm->n_color);
+  printf("vm.n_pages_mapped \t%ld\n", vm->n_page);
+  if (vm->policy == PALLOC_COLOR) printf("vm.n_off_color \t\t%ld\n", vm->n_off_color);
+  printf("vm.B_mapped \t\t%ld\n", vm->n_page << vm->n_page_bit);
+  for (int i = 0; i < vm->n_core; i++) {
+    tlb_stats_t *stats = &vm->stats[i];
+    printf("%d.tlb_accesses \t%ld\n", i, stats->n_access);
+    printf("%d.tlb_hits \t\t%ld\n", i, stats->n_hit);
+    printf("%d.tlb_hit_rate \t%.2f\n", i,
+           stats->n_access ? 100.0 * stats->n_hit / stats->n_access : 0.0);
+  }
+}
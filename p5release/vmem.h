@@ -0,0 +1,65 @@
+#ifndef __VMEM_H
+#define __VMEM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// physical memory size, log2. frames are tracked in a bitmap so the
+// maximum keeps that bitmap to a few tens of MB with 4KB pages
+#define VMEM_DEFAULT_PMEM_BIT 32
+#define VMEM_MAX_PMEM_BIT 40
+
+// where a newly touched virtual page is placed in physical memory
+enum palloc_t { PALLOC_SEQ, PALLOC_RANDOM, PALLOC_COLOR };
+
+typedef struct {
+  unsigned long vpn;
+  unsigned long pfn;
+  unsigned long last_use;  // for true LRU within a TLB set
+  bool valid;
+} tlb_entry_t;
+
+typedef struct {
+  long n_access;
+  long n_hit;
+} tlb_stats_t;
+
+typedef struct vmem_s {
+  int n_page_bit;          // 12 for 4KB pages, 21 for 2MB huge pages
+  enum palloc_t policy;
+
+  // page table, open addressing keyed by vpn + 1 (0 = empty slot).
+  // all cores share one address space, like the threads of a process
+  unsigned long *vpn;
+  unsigned long *pfn;
+  long capacity;           // always a power of 2
+  long n_page;
+
+  // physical frames
+  long n_frame;
+  uint8_t *used;           // one bit per frame
+  long next_frame;         // sequential allocation cursor
+  long n_color;            // page colors the cache index bits allow
+  long *next_in_color;     // page coloring cursor per color
+  long n_off_color;        // pages that got another color, theirs was full
+  unsigned long rng;
+
+  // one set associative TLB per core
+  int n_core;
+  int tlb_assoc;
+  int tlb_n_set;
+  tlb_entry_t **tlb;       // [core][set * assoc + way]
+  tlb_stats_t *stats;      // per core
+  unsigned long clock;
+} vmem_t;
+
+vmem_t *make_vmem(int n_core, int n_page_bit, enum palloc_t policy, int n_pmem_bit,
+                  int tlb_entries, int tlb_assoc, long cache_way_bytes, unsigned long seed);
+
+/* Translates a virtual address accessed by core, mapping its page on first touch. */
+unsigned long translate(vmem_t *vm, int core, unsigned long vaddr);
+
+char *palloc_to_str(enum palloc_t policy);
+void print_vmem(vmem_t *vm);
+
+#endif  // VMEM